@@ -0,0 +1,415 @@
+#include <mnv/mnv.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// mnv-bench [output.json]
+// Every measurement is one JSON record, the whole run is written to the file given (stdout by default),
+// so runs of different releases can be diffed.
+
+namespace
+{
+    // MNVGenerator keeps its factor inline, larger dimensions are measured with DynamicMNVGenerator (same kernels)
+    constexpr size_t maxStaticDim = 256;
+
+    struct Record
+    {
+        std::string benchmark;
+        std::string generator;
+        std::string type;
+        size_t dim{0};
+        std::vector<std::pair<std::string, double>> metrics{};
+    };
+
+    std::vector<Record> records;
+
+    template <typename T>
+    char const *typeName()
+    {
+        return sizeof(T) == sizeof(float) ? "float" : "double";
+    }
+
+    // Compound symmetry matrix: 1 on the diagonal, 0.5 elsewhere. Positive-definite and its factor is dense
+    // without tiny entries, so timings are not distorted by subnormal arithmetic.
+    template <typename T>
+    T covarianceEntry(size_t i, size_t j)
+    {
+        return static_cast<T>(i == j ? 1.0 : 0.5);
+    }
+
+    template <typename T, size_t Dim>
+    std::unique_ptr<mnv::MatrixSq<T, Dim>> makeCovariance()
+    {
+        auto covariance = std::make_unique<mnv::MatrixSq<T, Dim>>();
+        for (size_t i = 0; i < Dim; i++)
+        {
+            for (size_t j = 0; j < Dim; j++)
+            {
+                (*covariance)[i][j] = covarianceEntry<T>(i, j);
+            }
+        }
+        return covariance;
+    }
+
+    template <typename T>
+    std::vector<T> makeDynamicCovariance(size_t dim)
+    {
+        std::vector<T> covariance(dim * dim);
+        for (size_t i = 0; i < dim; i++)
+        {
+            for (size_t j = 0; j < dim; j++)
+            {
+                covariance[i * dim + j] = covarianceEntry<T>(i, j);
+            }
+        }
+        return covariance;
+    }
+
+    // Runs fn until at least minSeconds have passed, returns seconds per call
+    template <typename Fn>
+    double measure(Fn &&fn, double minSeconds = 0.2)
+    {
+        using clock = std::chrono::steady_clock;
+        size_t iterations = 0;
+        const auto start = clock::now();
+        double elapsed = 0;
+        do
+        {
+            fn();
+            iterations++;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < minSeconds);
+        return elapsed / static_cast<double>(iterations);
+    }
+
+    // build() time, validation and decomposition
+    template <typename T, size_t Dim>
+    void benchBuild()
+    {
+        const double cube = static_cast<double>(Dim) * static_cast<double>(Dim) * static_cast<double>(Dim);
+        size_t failures = 0;
+        double seconds = 0;
+
+        if constexpr (Dim <= maxStaticDim)
+        {
+            const auto covariance = makeCovariance<T, Dim>();
+            const mnv::valueVector<T, Dim> mean{};
+            seconds = measure([&]()
+                              {
+                auto gen = mnv::MNVGenerator<T, Dim>::build(*covariance, mean, 1);
+                failures += std::holds_alternative<mnv::MNVGeneratorBuildError>(gen); });
+        }
+        else
+        {
+            const auto covariance = makeDynamicCovariance<T>(Dim);
+            const std::vector<T> mean(Dim);
+            seconds = measure([&]()
+                              {
+                auto gen = mnv::DynamicMNVGenerator<T>::build(covariance, mean, 1);
+                failures += std::holds_alternative<mnv::MNVGeneratorBuildError>(gen); });
+        }
+
+        records.push_back({"build", Dim <= maxStaticDim ? "MNVGenerator" : "DynamicMNVGenerator", typeName<T>(), Dim,
+                           {{"seconds", seconds}, {"nsPerDim3", seconds * 1e9 / cube}, {"failures", static_cast<double>(failures)}}});
+    }
+
+    // nextValue() latency and nextValues() throughput
+    template <typename T, size_t Dim, typename Generator>
+    void benchSamplingWith(Generator &generator, char const *generatorName)
+    {
+        T sink{};
+        const double single = measure([&]()
+                                      {
+            for (size_t k = 0; k < 64; k++)
+            {
+                const auto value = generator.nextValue();
+                sink += value.empty() ? T{} : value.back();
+            } }) / 64;
+
+        constexpr size_t batch = 1024;
+        std::vector<T> values(batch * Dim);
+        const double batched = measure([&]()
+                                       {
+            generator.nextValues(values.data(), batch);
+            sink += values[0]; }) / batch;
+        const double antithetic = measure([&]()
+                                          {
+            generator.nextAntitheticValues(values.data(), batch);
+            sink += values[0]; }) / batch;
+
+        std::vector<T> scores(batch);
+        const double scoring = measure([&]()
+                                       {
+            generator.logPdf(values.data(), batch, scores.data());
+            sink += scores[0]; }) / batch;
+
+        records.push_back({"nextValue", generatorName, typeName<T>(), Dim,
+                           {{"secondsPerValue", single}, {"valuesPerSecond", 1 / single}}});
+        records.push_back({"nextValues", generatorName, typeName<T>(), Dim,
+                           {{"secondsPerValue", batched}, {"valuesPerSecond", 1 / batched}, {"batch", static_cast<double>(batch)},
+                            {"speedup", single / batched}, {"checksum", static_cast<double>(sink)}}});
+        records.push_back({"nextAntitheticValues", generatorName, typeName<T>(), Dim,
+                           {{"secondsPerValue", antithetic}, {"valuesPerSecond", 1 / antithetic}, {"batch", static_cast<double>(batch)},
+                            {"speedup", batched / antithetic}}});
+        records.push_back({"logPdf", generatorName, typeName<T>(), Dim,
+                           {{"secondsPerPoint", scoring}, {"pointsPerSecond", 1 / scoring}, {"batch", static_cast<double>(batch)}}});
+    }
+
+    template <typename T, size_t Dim>
+    void benchSampling()
+    {
+        if constexpr (Dim <= maxStaticDim)
+        {
+            auto generator = std::get<mnv::MNVGenerator<T, Dim>>(mnv::MNVGenerator<T, Dim>::build(*makeCovariance<T, Dim>(), {}, 1));
+            benchSamplingWith<T, Dim>(generator, "MNVGenerator");
+        }
+        else
+        {
+            auto generator = std::get<mnv::DynamicMNVGenerator<T>>(
+                mnv::DynamicMNVGenerator<T>::build(makeDynamicCovariance<T>(Dim), std::vector<T>(Dim), 1));
+            benchSamplingWith<T, Dim>(generator, "DynamicMNVGenerator");
+        }
+    }
+
+    // calculateCovarianceMatrix() and calculateMeanVector() over generated samples
+    template <typename T, size_t Dim>
+    void benchEstimation()
+    {
+        // about 4M elements, at least 4 samples per dimension
+        const size_t samples = std::max<size_t>(4 * Dim, (size_t{1} << 22) / Dim);
+        std::vector<mnv::valueVector<T, Dim>> values(samples);
+        {
+            auto generator = std::get<mnv::DynamicMNVGenerator<T>>(
+                mnv::DynamicMNVGenerator<T>::build(makeDynamicCovariance<T>(Dim), std::vector<T>(Dim), 1));
+            generator.nextValues(values.data()->data(), values.size());
+        }
+
+        auto covariance = std::make_unique<mnv::MatrixSq<T, Dim>>();
+        const double covarianceSeconds = measure([&]()
+                                                 { mnv::calculateCovarianceMatrix(values, *covariance); });
+
+        T sink{};
+        const double meanSeconds = measure([&]()
+                                           { sink += mnv::calculateMeanVector(values)[0]; });
+
+        const double elements = static_cast<double>(samples) * static_cast<double>(Dim);
+        records.push_back({"calculateCovarianceMatrix", "", typeName<T>(), Dim,
+                           {{"seconds", covarianceSeconds}, {"samples", static_cast<double>(samples)},
+                            {"nsPerSampleDim2", covarianceSeconds * 1e9 / (elements * static_cast<double>(Dim))}}});
+        records.push_back({"calculateMeanVector", "", typeName<T>(), Dim,
+                           {{"seconds", meanSeconds}, {"samples", static_cast<double>(samples)},
+                            {"nsPerElement", meanSeconds * 1e9 / elements}, {"checksum", static_cast<double>(sink)}}});
+    }
+
+    template <typename T, size_t... Dims>
+    void benchAll(std::index_sequence<Dims...>)
+    {
+        (benchBuild<T, Dims>(), ...);
+        (benchSampling<T, Dims>(), ...);
+        (benchEstimation<T, Dims>(), ...);
+    }
+
+    // blocked factorization for large runtime dimensions, single-threaded and on every core
+    template <typename T>
+    void benchBuildThreads(size_t dim, size_t threads)
+    {
+        const auto covariance = makeDynamicCovariance<T>(dim);
+        const std::vector<T> mean(dim);
+        size_t failures = 0;
+
+        const double seconds = measure([&]()
+                                       {
+            auto gen = mnv::DynamicMNVGenerator<T>::build(covariance, mean, 1, threads);
+            failures += std::holds_alternative<mnv::MNVGeneratorBuildError>(gen); });
+
+        records.push_back({"buildThreads", "DynamicMNVGenerator", typeName<T>(), dim,
+                           {{"seconds", seconds}, {"threads", static_cast<double>(threads)}, {"failures", static_cast<double>(failures)}}});
+    }
+
+    // calculateCovarianceMatrix() as it was before the blocked implementation, kept as the baseline
+    template <typename T, size_t Dim>
+    mnv::MatrixSq<T, Dim> naiveCovarianceMatrix(std::vector<mnv::valueVector<T, Dim>> const &inputVectors)
+    {
+        mnv::MatrixSq<T, Dim> result{};
+        const auto mean = mnv::calculateMeanVector(inputVectors);
+        for (size_t i = 0; i < Dim; i++)
+        {
+            for (size_t j = 0; j < Dim; j++)
+            {
+                for (size_t k = 0; k < inputVectors.size(); k++)
+                {
+                    result[i][j] += (inputVectors[k][i] - mean[i]) * (inputVectors[k][j] - mean[j]);
+                }
+                result[i][j] /= (static_cast<T>(inputVectors.size()) - 1);
+            }
+        }
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    void benchCovarianceBaseline(size_t samples, size_t cores)
+    {
+        auto generator = std::get<mnv::MNVGenerator<T, Dim>>(mnv::MNVGenerator<T, Dim>::build(*makeCovariance<T, Dim>(), {}, 1));
+        std::vector<mnv::valueVector<T, Dim>> values(samples);
+        generator.nextValues(values.data(), values.size());
+
+        T sink{};
+        const double naive = measure([&]()
+                                     { sink += naiveCovarianceMatrix(values)[Dim - 1][0]; });
+        const double blocked = measure([&]()
+                                       { sink += mnv::calculateCovarianceMatrix(values)[Dim - 1][0]; });
+        const double threaded = measure([&]()
+                                        { sink += mnv::calculateCovarianceMatrix(values, cores)[Dim - 1][0]; });
+
+        records.push_back({"covarianceBaseline", "", typeName<T>(), Dim,
+                           {{"samples", static_cast<double>(samples)}, {"naiveSeconds", naive}, {"blockedSeconds", blocked},
+                            {"threadedSeconds", threaded}, {"threads", static_cast<double>(cores)}, {"checksum", static_cast<double>(sink)}}});
+    }
+
+    // mixture sampling: generator per component picked by a linear scan over cumulative weights, vs MixtureMNVGenerator
+    template <typename T, size_t Dim>
+    void benchMixture(size_t components)
+    {
+        const auto covariance = makeCovariance<T, Dim>();
+        std::vector<T> weights(components);
+        std::vector<mnv::MatrixSq<T, Dim>> covariances(components, *covariance);
+        std::vector<mnv::valueVector<T, Dim>> means(components);
+        std::vector<mnv::MNVGenerator<T, Dim>> generators{};
+        std::vector<double> cumulative(components);
+        double total = 0;
+        for (size_t c = 0; c < components; c++)
+        {
+            weights[c] = static_cast<T>(c + 1);
+            means[c].fill(static_cast<T>(c));
+            generators.push_back(std::get<mnv::MNVGenerator<T, Dim>>(mnv::MNVGenerator<T, Dim>::build(*covariance, means[c], c + 1)));
+            total += static_cast<double>(weights[c]);
+            cumulative[c] = total;
+        }
+        auto mixture = std::get<mnv::MixtureMNVGenerator<T, Dim>>(mnv::MixtureMNVGenerator<T, Dim>::build(weights, covariances, means, 1));
+
+        constexpr size_t batch = 1024;
+        std::vector<mnv::valueVector<T, Dim>> values(batch);
+        std::mt19937 picker{1};
+        std::uniform_real_distribution<double> uniform{0, total};
+        T sink{};
+        const double scan = measure([&]()
+                                    {
+            for (auto &&value : values)
+            {
+                const double u = uniform(picker);
+                size_t c = 0;
+                while (c + 1 < components && cumulative[c] <= u)
+                {
+                    c++;
+                }
+                value = generators[c].nextValue();
+            }
+            sink += values[0][0]; }) / batch;
+        const double grouped = measure([&]()
+                                       {
+            mixture.nextValues(values.data(), batch);
+            sink += values[0][0]; }) / batch;
+
+        records.push_back({"mixture", "MixtureMNVGenerator", typeName<T>(), Dim,
+                           {{"components", static_cast<double>(components)}, {"scanSecondsPerValue", scan},
+                            {"secondsPerValue", grouped}, {"speedup", scan / grouped}, {"checksum", static_cast<double>(sink)}}});
+    }
+
+    // nextValue() on a mixture, should cost the same whatever the number of components
+    template <typename T, size_t Dim>
+    void benchMixtureNextValue(size_t components)
+    {
+        const auto covariance = makeCovariance<T, Dim>();
+        std::vector<T> weights(components);
+        std::vector<mnv::valueVector<T, Dim>> means(components);
+        for (size_t c = 0; c < components; c++)
+        {
+            weights[c] = static_cast<T>(c % 7 + 1);
+            means[c].fill(static_cast<T>(c));
+        }
+        auto mixture = std::get<mnv::MixtureMNVGenerator<T, Dim>>(mnv::MixtureMNVGenerator<T, Dim>::build(
+            weights, std::vector<mnv::MatrixSq<T, Dim>>(components, *covariance), means, 1));
+
+        T sink{};
+        const double single = measure([&]()
+                                      { sink += mixture.nextValue()[Dim - 1]; });
+
+        records.push_back({"mixtureNextValue", "MixtureMNVGenerator", typeName<T>(), Dim,
+                           {{"components", static_cast<double>(components)}, {"secondsPerValue", single},
+                            {"checksum", static_cast<double>(sink)}}});
+    }
+
+    void writeJson(std::FILE *out)
+    {
+        std::fprintf(out, "{\n  \"library\": \"mnv\",\n  \"results\": [");
+        for (size_t r = 0; r < records.size(); r++)
+        {
+            Record const &record = records[r];
+            std::fprintf(out, "%s\n    {\"benchmark\": \"%s\", \"generator\": \"%s\", \"type\": \"%s\", \"dim\": %zu",
+                         r ? "," : "", record.benchmark.c_str(), record.generator.c_str(), record.type.c_str(), record.dim);
+            for (auto &&metric : record.metrics)
+            {
+                // JSON has no literals for inf and NaN
+                if (std::isfinite(metric.second))
+                {
+                    std::fprintf(out, ", \"%s\": %.9g", metric.first.c_str(), metric.second);
+                }
+                else
+                {
+                    std::fprintf(out, ", \"%s\": null", metric.first.c_str());
+                }
+            }
+            std::fprintf(out, "}");
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    using dims = std::index_sequence<2, 5, 16, 64, 256, 1024>;
+    benchAll<float>(dims{});
+    benchAll<double>(dims{});
+
+    const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (size_t dim : {size_t{512}, size_t{1024}, size_t{2048}})
+    {
+        benchBuildThreads<double>(dim, 1);
+        if (cores > 1)
+        {
+            benchBuildThreads<double>(dim, cores);
+        }
+    }
+
+    // covariance estimation, previous implementation vs blocked lower-triangle one
+    benchCovarianceBaseline<double, 16>(100000, cores);
+    benchCovarianceBaseline<double, 64>(50000, cores);
+    benchCovarianceBaseline<double, 200>(20000, cores);
+
+    // mixtures, few and many components
+    benchMixture<double, 16>(8);
+    benchMixture<double, 16>(256);
+    benchMixtureNextValue<double, 2>(4);
+    benchMixtureNextValue<double, 2>(65536);
+
+    std::FILE *out = argc > 1 ? std::fopen(argv[1], "w") : stdout;
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "mnv-bench: can not open %s\n", argv[1]);
+        return 1;
+    }
+    writeJson(out);
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -47,11 +47,10 @@ int main(int, char *[])
 
     auto generator = std::get<mnv::MNVGenerator<float, 5>>(gen_packed);
     std::cout << "Generating samples:" << std::endl;
-    std::vector<mnv::valueVector<float, 5>> values;
-    for (size_t i = 0; i < 100000; i++)
-    {
-        values.push_back(generator.nextValue());
-    }
+    // batched generation writes straight into the buffer,
+    // same values as 100000 generator.nextValue() calls
+    std::vector<mnv::valueVector<float, 5>> values(100000);
+    generator.nextValues(values.data(), values.size());
 
     // printMatrix(values);
 
@@ -3,12 +3,57 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
 #include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include <mnv/mnv-sobol.hpp>
+
+#if !defined(MNV_DISABLE_SIMD) && defined(__AVX512F__)
+#define MNV_SIMD_AVX512
+#include <immintrin.h>
+#elif !defined(MNV_DISABLE_SIMD) && defined(__AVX2__)
+#define MNV_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+// Snapshot files are memory-mapped where POSIX mmap() is available, read into memory elsewhere
+#if !defined(MNV_DISABLE_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define MNV_SNAPSHOT_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// GCC fuses a * b + c into fma across statements when FMA is available, which changes the last bits.
+// The portable sampler must round every operation on its own. Clang only fuses within one expression
+// by default, so the affected code keeps each multiplication and addition in a separate statement.
+#if defined(__GNUC__) && !defined(__clang__)
+#define MNV_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define MNV_NO_FP_CONTRACT
+#endif
+
 namespace mnv
 {
     template <typename T, size_t Dim>
@@ -17,6 +62,9 @@ namespace mnv
     template <typename T, size_t Dim>
     using MatrixSq = valueVector<valueVector<T, Dim>, Dim>;
 
+    template <typename T, size_t Dim>
+    using MatrixLowerTriangular = valueVector<T, Dim * (Dim + 1) / 2>;
+
     namespace internal
     {
         template <typename T, size_t Dim>
@@ -189,8 +237,25 @@ namespace mnv
             return sumOfProductsUntil(vector, vector, idx);
         }
 
+        // matrix is dim x dim row-major
+        template <typename T>
+        constexpr bool isMatrixSymmetric(T const *matrix, size_t dim)
+        {
+            for (size_t i = 0; i < dim; i++)
+            {
+                for (size_t j = i + 1; j < dim; j++)
+                {
+                    if (matrix[i * dim + j] != matrix[j * dim + i])
+                    {
+                        return false;
+                    }
+                }
+            }
+            return dim > 0;
+        }
+
         template <typename MatrixType>
-        inline bool isMatrixSymmetric(MatrixType const &matrix)
+        constexpr bool isMatrixSymmetric(MatrixType const &matrix)
         {
             if (matrix.empty())
             {
@@ -215,176 +280,5018 @@ namespace mnv
             return true;
         }
 
-        template <typename T, size_t Dim>
-        MatrixSq<T, Dim> doCholetskyDecomposition(MatrixSq<T, Dim> const &matrix)
+        // Helper threads kept for runParallel(), started on first use and grown to the largest count asked for, so
+        // repeated parallel calls do not pay for creating and joining threads. It runs one job at a time: a caller that
+        // finds it busy, e.g. a nested or a concurrent runParallel(), falls back to threads of its own.
+        class WorkerPool
         {
-            MatrixSq<T, Dim> result{};
-            // 3. Decomposition itself
-            result[0][0] = std::sqrt(matrix[0][0]);
+        public:
+            static WorkerPool &instance()
+            {
+                static WorkerPool pool{};
+                return pool;
+            }
+
+            // Runs work() on helpers helper threads and on the calling one, false if the pool is busy.
+            // Returns only once every helper is done with work. The first exception thrown by work() on any thread
+            // is rethrown here; if helper threads can not be started, the ones there are do the job.
+            template <typename Work>
+            bool tryRun(size_t helpers, Work const &work)
+            {
+                bool expected = false;
+                if (!m_busy.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                {
+                    return false;
+                }
+                struct Release
+                {
+                    std::atomic<bool> &busy;
+                    ~Release() { busy.store(false, std::memory_order_release); }
+                } release{m_busy};
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    try
+                    {
+                        while (m_threads.size() < helpers)
+                        {
+                            m_threads.emplace_back([this, id = m_threads.size()]()
+                                                   { loop(id); });
+                        }
+                    }
+                    catch (...)
+                    {
+                        helpers = m_threads.size();
+                    }
+                    m_invoke = [](void const *context)
+                    { (*static_cast<Work const *>(context))(); };
+                    m_context = &work;
+                    m_helpers = helpers;
+                    m_running = helpers;
+                    m_failure = nullptr;
+                    m_generation++;
+                }
+                m_wake.notify_all();
+
+                std::exception_ptr failure{};
+                try
+                {
+                    work();
+                }
+                catch (...)
+                {
+                    failure = std::current_exception();
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_done.wait(lock, [this]()
+                                { return m_running == 0; });
+                    if (!failure)
+                    {
+                        failure = m_failure;
+                    }
+                    m_failure = nullptr;
+                }
+                if (failure)
+                {
+                    std::rethrow_exception(failure);
+                }
+                return true;
+            }
 
-            for (size_t i = 1; i < matrix.size(); i++)
+            ~WorkerPool()
             {
-                result[i][0] = matrix[i][0] / result[0][0];
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stop = true;
+                }
+                m_wake.notify_all();
+                for (auto &thread : m_threads)
+                {
+                    thread.join();
+                }
             }
 
-            for (size_t j = 1; j < matrix.size(); j++)
+        private:
+            WorkerPool() = default;
+
+            void loop(size_t id)
             {
-                for (size_t i = j; i < matrix.size(); i++)
+                size_t seen = 0;
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (;;)
                 {
+                    m_wake.wait(lock, [&]()
+                                { return m_stop || m_generation != seen; });
+                    if (m_stop)
+                    {
+                        return;
+                    }
+                    seen = m_generation;
+                    if (id >= m_helpers)
+                    {
+                        continue;
+                    }
 
-                    if (i == j)
+                    void (*invoke)(void const *) = m_invoke;
+                    void const *context = m_context;
+                    lock.unlock();
+                    std::exception_ptr failure{};
+                    try
                     {
-                        result[i][j] = std::sqrt(matrix[i][i] - sumOfSquaresUntil(result[i], j));
+                        invoke(context);
                     }
-                    else
+                    catch (...)
+                    {
+                        failure = std::current_exception();
+                    }
+                    lock.lock();
+                    if (failure && !m_failure)
+                    {
+                        m_failure = failure;
+                    }
+                    if (--m_running == 0)
                     {
-                        result[i][j] = (matrix[i][j] - sumOfProductsUntil(result[i], result[j], j)) / result[j][j];
+                        m_done.notify_one();
                     }
                 }
             }
 
-            return result;
-        }
+            std::atomic<bool> m_busy{false};
+            std::mutex m_mutex{};
+            std::condition_variable m_wake{};
+            std::condition_variable m_done{};
+            std::vector<std::thread> m_threads{};
 
-        template <typename T, size_t Dim>
-        valueVector<T, Dim> multiplyMatrixByVector(MatrixSq<T, Dim> const &matrix, valueVector<T, Dim> const &vector)
+            // the current job, guarded by m_mutex
+            void (*m_invoke)(void const *){nullptr};
+            void const *m_context{nullptr};
+            size_t m_helpers{0};
+            size_t m_running{0};
+            size_t m_generation{0};
+            std::exception_ptr m_failure{}; // first exception of a helper
+            bool m_stop{false};
+        };
+
+        // Runs task(index) for every index in [0, count) on up to threads threads, the calling one included.
+        // The helper threads come from WorkerPool, fresh ones are only started if it is busy.
+        // If a task throws, no further indices are started and the first exception is rethrown once all threads are done.
+        template <typename Task>
+        void runParallel(size_t count, size_t threads, Task const &task)
         {
-            valueVector<T, Dim> result{};
-            for (size_t i = 0; i < result.size(); i++)
+            if (threads == 0)
             {
-                result[i] = vectorDotProduct(matrix[i], vector);
+                threads = std::max<size_t>(1, std::thread::hardware_concurrency());
             }
+            threads = std::min(threads, count);
 
-            return result;
+            std::atomic<size_t> next{0};
+            std::mutex failureMutex{};
+            std::exception_ptr failure{};
+            auto worker = [&]()
+            {
+                try
+                {
+                    for (size_t index = next++; index < count; index = next++)
+                    {
+                        task(index);
+                    }
+                }
+                catch (...)
+                {
+                    next = count;
+                    std::lock_guard<std::mutex> lock(failureMutex);
+                    if (!failure)
+                    {
+                        failure = std::current_exception();
+                    }
+                }
+            };
+
+            if (threads <= 1)
+            {
+                worker();
+            }
+            else if (!WorkerPool::instance().tryRun(threads - 1, worker))
+            {
+                // as many threads as can be started, the calling one does the rest
+                std::vector<std::thread> pool;
+                try
+                {
+                    pool.reserve(threads - 1);
+                    for (size_t i = 1; i < threads; i++)
+                    {
+                        pool.emplace_back(worker);
+                    }
+                }
+                catch (...)
+                {
+                }
+                worker();
+
+                for (auto &thread : pool)
+                {
+                    thread.join();
+                }
+            }
+
+            if (failure)
+            {
+                std::rethrow_exception(failure);
+            }
         }
-    } // namespace internal
 
-    template <typename T, size_t Dim>
-    valueVector<T, Dim> MNVGenerator<T, Dim>::nextValue()
-    {
-        valueVector<T, Dim> randomStandardNormalVector{};
+        // offset of the first element of a row in packed lower-triangular storage
+        constexpr size_t packedRowOffset(size_t row)
+        {
+            return row * (row + 1) / 2;
+        }
 
-        for (size_t i = 0; i < randomStandardNormalVector.size(); i++)
+        // Square root usable in constant expressions, std::sqrt is not constexpr.
+        // Newton-Raphson from above decreases monotonically, it stops once the estimate does not decrease anymore.
+        template <typename T>
+        constexpr T constexprSqrt(T value)
         {
-            randomStandardNormalVector[i] = distribution(m_generator);
+            if (!(value > 0) || value == std::numeric_limits<T>::infinity())
+            {
+                return value == 0 || value == std::numeric_limits<T>::infinity() ? value : std::numeric_limits<T>::quiet_NaN();
+            }
+
+            T current = value > 1 ? value : T(1);
+            while (true)
+            {
+                const T next = (current + value / current) / 2;
+                if (!(next < current))
+                {
+                    return current;
+                }
+                current = next;
+            }
         }
 
-        valueVector<T, Dim> multipliedVector =
-            internal::multiplyMatrixByVector(m_decomposedCovariance, randomStandardNormalVector);
-        return internal::addVectors(multipliedVector, m_mean);
-    }
+        // Unblocked Choletsky decomposition usable in constant expressions, same pivot tolerance as the runtime one
+        template <typename T, size_t Dim>
+        constexpr bool tryCholetskyDecompositionConstexpr(MatrixSq<T, Dim> const &matrix, MatrixLowerTriangular<T, Dim> &result)
+        {
+            for (size_t i = 0; i < Dim; i++)
+            {
+                const size_t rowI = packedRowOffset(i);
+                for (size_t j = 0; j <= i; j++)
+                {
+                    const size_t rowJ = packedRowOffset(j);
+                    T sum = matrix[i][j];
+                    for (size_t k = 0; k < j; k++)
+                    {
+                        sum -= result[rowI + k] * result[rowJ + k];
+                    }
 
-    template <typename T, size_t Dim>
-    std::variant<MNVGenerator<T, Dim>, MNVGeneratorBuildError>
-    MNVGenerator<T, Dim>::build(
-        MatrixSq<T, Dim> const &covariance,
-        valueVector<T, Dim> const &mean,
-        size_t seed)
-    {
-        using ::mnv::internal::MatrixDefinition;
+                    if (i == j)
+                    {
+                        const T tolerance = std::numeric_limits<T>::epsilon() * static_cast<T>(Dim) * matrix[i][i];
+                        if (!(sum > tolerance))
+                        {
+                            return false;
+                        }
+                        result[rowI + i] = constexprSqrt(sum);
+                    }
+                    else
+                    {
+                        result[rowI + j] = sum / result[rowJ + j];
+                    }
+                }
+            }
+            return true;
+        }
 
-        // 1. Check for symmetric matrix
+        // Not constexpr on purpose: reaching one of these in a constant expression turns an invalid matrix into a compile error
+        inline void covarianceMatrixIsNotSymmetric() {}
+        inline void covarianceMatrixIsNotPositiveDefinite() {}
 
-        if (!internal::isMatrixSymmetric(covariance))
+        template <typename T, size_t Dim>
+        constexpr CovarianceFactor<T, Dim> requireValidFactor(CovarianceFactor<T, Dim> const &factor)
         {
-            // error: ABSOLUTELY wrong matrix
-            return MNVGeneratorBuildError{
-                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
-                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+            if (!factor.valid && factor.error == MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric)
+            {
+                covarianceMatrixIsNotSymmetric();
+            }
+            if (!factor.valid && factor.error == MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite)
+            {
+                covarianceMatrixIsNotPositiveDefinite();
+            }
+            return factor;
         }
 
-        // 2. Check for positive-definite matrix
-
-        MatrixDefinition def = internal::defineMatrix(covariance);
-        switch (def)
+        template <typename T, size_t Dim>
+        MatrixLowerTriangular<T, Dim> packLowerTriangular(MatrixSq<T, Dim> const &matrix)
         {
-        case MatrixDefinition::NegativeDefinite: // error: how tf you did that (wrong matrix)?
-        case MatrixDefinition::Undefinite:       // error: how tf you did that (wrong matrix)?
-            return MNVGeneratorBuildError{
-                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
-                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+            MatrixLowerTriangular<T, Dim> result{};
+            for (size_t i = 0; i < Dim; i++)
+            {
+                std::copy(matrix[i].begin(), matrix[i].begin() + i + 1, result.begin() + packedRowOffset(i));
+            }
 
-        case MatrixDefinition::PositiveDefinite: // ok
-            break;
-        default:
-            break;
+            return result;
         }
 
-        return MNVGenerator<T, Dim>(
-            internal::doCholetskyDecomposition(covariance), mean, seed);
-    }
+        template <typename T, size_t Dim>
+        MatrixSq<T, Dim> unpackLowerTriangular(MatrixLowerTriangular<T, Dim> const &packed)
+        {
+            MatrixSq<T, Dim> result{};
+            for (size_t i = 0; i < Dim; i++)
+            {
+                std::copy(packed.begin() + packedRowOffset(i), packed.begin() + packedRowOffset(i + 1), result[i].begin());
+            }
 
-    template <typename T, size_t Dim>
-    std::variant<MNVGenerator<T, Dim>, MNVGeneratorBuildError>
-    MNVGenerator<T, Dim>::build(
-        std::vector<valueVector<T, Dim>> const &statisticVectors,
-        size_t seed)
-    {
-        return build(calculateCovarianceMatrix(statisticVectors),
-                     calculateMeanVector(statisticVectors),
-                     seed);
-    }
+            return result;
+        }
 
-    template <typename T, size_t Dim>
-    void MNVGenerator<T, Dim>::seed(size_t seed)
-    {
-        m_generator.seed(seed);
-        return;
-    }
+        // Blocked right-looking Choletsky decomposition, in place on packed lower-triangular storage.
+        //
+        // Attempts the decomposition and stops at the first pivot that is not positive.
+        // A symmetric matrix is positive-definite exactly when this succeeds, so the
+        // factorization doubles as the definiteness check (O(n^3) instead of O(n!) minors).
+        //
+        // The matrix is processed in panels of choletskyBlockSize columns: the diagonal block is factored,
+        // the rows below it are solved against it, and the trailing matrix is updated tile by tile.
+        // Tiles of choletskyBlockSize x choletskyBlockSize stay in L1/L2 and every row segment is
+        // contiguous in packed storage. The panel solve and the trailing update can run on several threads.
+        // For dim <= choletskyBlockSize this is exactly the unblocked row-by-row algorithm.
+        constexpr size_t choletskyBlockSize = 64;
+        constexpr size_t choletskyParallelThreshold = 256; // smaller trailing matrices are updated on one thread
 
-    // private constructor is used to force MNVGenerator::build()
-    template <typename T, size_t Dim>
-    MNVGenerator<T, Dim>::MNVGenerator(MatrixSq<T, Dim> decomposedCovariance, valueVector<T, Dim> mean, size_t seed)
-        : m_decomposedCovariance(decomposedCovariance), m_mean(mean)
-    {
-        if (seed == 0)
+        // rows [first, last) of the panel [k0, k0 + kb), rows inside the diagonal block also get their pivot
+        template <typename T>
+        bool choletskyPanelRows(T *packed, T const *originalDiagonal, size_t dim, size_t k0, size_t kb, size_t first, size_t last)
         {
-            std::random_device rd{};
-            seed = rd();
-        }
-        m_seed = seed;
-        m_generator.seed(seed);
-    }
+            for (size_t i = first; i < last; i++)
+            {
+                T *rowI = packed + packedRowOffset(i);
+                const size_t panelEnd = std::min(i, k0 + kb);
 
-    template <typename T, size_t Dim>
-    valueVector<T, Dim> calculateMeanVector(std::vector<valueVector<T, Dim>> const &inputVectors)
-    {
-        valueVector<T, Dim> result{};
+                for (size_t j = k0; j < panelEnd; j++)
+                {
+                    T const *rowJ = packed + packedRowOffset(j);
 
-        for (auto &&vec : inputVectors)
-        {
-            result = internal::addVectors(result, vec);
+                    T sum = 0;
+                    for (size_t k = k0; k < j; k++)
+                    {
+                        sum += rowI[k] * rowJ[k];
+                    }
+                    rowI[j] = (rowI[j] - sum) / rowJ[j];
+                }
+
+                if (i < k0 + kb)
+                {
+                    T sumOfSquares = 0;
+                    for (size_t k = k0; k < i; k++)
+                    {
+                        sumOfSquares += rowI[k] * rowI[k];
+                    }
+
+                    // pivots this close to zero are indistinguishable from rounding noise
+                    const T tolerance = std::numeric_limits<T>::epsilon() * static_cast<T>(dim) * originalDiagonal[i];
+                    const T pivot = rowI[i] - sumOfSquares;
+                    if (!(pivot > tolerance))
+                    {
+                        return false;
+                    }
+
+                    rowI[i] = std::sqrt(pivot);
+                }
+            }
+
+            return true;
         }
 
-        for (size_t i = 0; i < result.size(); i++)
+        // A[i][j] -= sum over the panel [k0, k0 + kb) of L[i][k] * L[j][k] for j <= i in columns [columnsFirst, columnsLast)
+        template <typename T>
+        void choletskyTrailingRow(T *packed, size_t k0, size_t kb, size_t i, size_t columnsFirst, size_t columnsLast)
         {
-            result[i] /= static_cast<T>(inputVectors.size());
+            T *rowI = packed + packedRowOffset(i);
+            T const *panelI = rowI + k0;
+            const size_t last = std::min(columnsLast, i + 1);
+
+            for (size_t j = columnsFirst; j < last; j++)
+            {
+                T const *panelJ = packed + packedRowOffset(j) + k0;
+
+                T acc{};
+                for (size_t k = 0; k < kb; k++)
+                {
+                    acc += panelI[k] * panelJ[k];
+                }
+                rowI[j] -= acc;
+            }
         }
 
-        return result;
-    }
+        // Trailing update of one tile. Two rows and four columns are handled at once,
+        // so every loaded panel element feeds several independent accumulators.
+        template <typename T>
+        void choletskyTrailingTile(T *packed, size_t k0, size_t kb, size_t rowsFirst, size_t rowsLast, size_t columnsFirst, size_t columnsLast)
+        {
+            size_t i = rowsFirst;
+            for (; i + 2 <= rowsLast; i += 2)
+            {
+                T *rowA = packed + packedRowOffset(i);
+                T *rowB = packed + packedRowOffset(i + 1);
+                T const *panelA = rowA + k0;
+                T const *panelB = rowB + k0;
+                // columns both rows have, i.e. j <= i
+                const size_t shared = std::min(columnsLast, i + 1);
 
-    template <typename T, size_t Dim>
-    MatrixSq<T, Dim> calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &inputVectors)
-    {
-        MatrixSq<T, Dim> result{};
+                size_t j = columnsFirst;
+                for (; j + 4 <= shared; j += 4)
+                {
+                    T const *panel0 = packed + packedRowOffset(j) + k0;
+                    T const *panel1 = packed + packedRowOffset(j + 1) + k0;
+                    T const *panel2 = packed + packedRowOffset(j + 2) + k0;
+                    T const *panel3 = packed + packedRowOffset(j + 3) + k0;
 
-        valueVector<T, Dim> mean = calculateMeanVector(inputVectors);
+                    T a0{}, a1{}, a2{}, a3{}, b0{}, b1{}, b2{}, b3{};
+                    for (size_t k = 0; k < kb; k++)
+                    {
+                        a0 += panelA[k] * panel0[k];
+                        a1 += panelA[k] * panel1[k];
+                        a2 += panelA[k] * panel2[k];
+                        a3 += panelA[k] * panel3[k];
+                        b0 += panelB[k] * panel0[k];
+                        b1 += panelB[k] * panel1[k];
+                        b2 += panelB[k] * panel2[k];
+                        b3 += panelB[k] * panel3[k];
+                    }
 
-        for (size_t i = 0; i < result.size(); i++)
+                    rowA[j] -= a0;
+                    rowA[j + 1] -= a1;
+                    rowA[j + 2] -= a2;
+                    rowA[j + 3] -= a3;
+                    rowB[j] -= b0;
+                    rowB[j + 1] -= b1;
+                    rowB[j + 2] -= b2;
+                    rowB[j + 3] -= b3;
+                }
+
+                choletskyTrailingRow(packed, k0, kb, i, j, columnsLast);
+                choletskyTrailingRow(packed, k0, kb, i + 1, j, columnsLast);
+            }
+
+            for (; i < rowsLast; i++)
+            {
+                choletskyTrailingRow(packed, k0, kb, i, columnsFirst, columnsLast);
+            }
+        }
+
+        // packed holds the lower triangle of a symmetric matrix and receives the factor
+        template <typename T>
+        bool tryCholetskyDecompositionInPlace(T *packed, size_t dim, size_t threads = 1)
         {
-            for (size_t j = 0; j < result.size(); j++)
+            std::vector<T> originalDiagonal(dim);
+            for (size_t i = 0; i < dim; i++)
+            {
+                originalDiagonal[i] = packed[packedRowOffset(i) + i];
+            }
+
+            for (size_t k0 = 0; k0 < dim; k0 += choletskyBlockSize)
             {
-                for (size_t k = 0; k < inputVectors.size(); k++)
+                const size_t kb = std::min(choletskyBlockSize, dim - k0);
+                const size_t trailing = k0 + kb;
+                const size_t trailingBlocks = (dim - trailing + choletskyBlockSize - 1) / choletskyBlockSize;
+                const size_t stepThreads = dim - trailing >= choletskyParallelThreshold ? threads : 1;
+
+                // 1. diagonal block, its failure means the matrix is not positive-definite
+                if (!choletskyPanelRows(packed, originalDiagonal.data(), dim, k0, kb, k0, trailing))
                 {
-                    result[i][j] += (inputVectors[k][i] - mean[i]) * (inputVectors[k][j] - mean[j]);
+                    return false;
                 }
 
-                result[i][j] /= (static_cast<T>(inputVectors.size()) - 1);
+                // 2. rows below the diagonal block, independent of each other
+                runParallel(trailingBlocks, stepThreads, [&](size_t block)
+                            {
+                    const size_t first = trailing + block * choletskyBlockSize;
+                    choletskyPanelRows(packed, originalDiagonal.data(), dim, k0, kb, first, std::min(dim, first + choletskyBlockSize)); });
+
+                // 3. trailing matrix, lower-triangular tiles are independent of each other
+                const size_t tiles = trailingBlocks * (trailingBlocks + 1) / 2;
+                runParallel(tiles, stepThreads, [&](size_t tile)
+                            {
+                    // tile -> (row block, column block) in packed order
+                    size_t rowBlock = static_cast<size_t>((std::sqrt(8.0 * static_cast<double>(tile) + 1.0) - 1.0) / 2.0);
+                    while (packedRowOffset(rowBlock + 1) <= tile)
+                    {
+                        rowBlock++;
+                    }
+                    while (packedRowOffset(rowBlock) > tile)
+                    {
+                        rowBlock--;
+                    }
+                    const size_t columnBlock = tile - packedRowOffset(rowBlock);
+
+                    const size_t rowsFirst = trailing + rowBlock * choletskyBlockSize;
+                    const size_t columnsFirst = trailing + columnBlock * choletskyBlockSize;
+                    choletskyTrailingTile(packed, k0, kb,
+                                          rowsFirst, std::min(dim, rowsFirst + choletskyBlockSize),
+                                          columnsFirst, std::min(dim, columnsFirst + choletskyBlockSize)); });
             }
+
+            return true;
         }
 
-        return result;
+        // matrix is dim x dim row-major, its lower triangle is copied into packed storage
+        template <typename T>
+        void packLowerTriangular(T const *matrix, size_t dim, T *result)
+        {
+            for (size_t i = 0; i < dim; i++)
+            {
+                std::copy(matrix + i * dim, matrix + i * dim + i + 1, result + packedRowOffset(i));
+            }
+        }
+
+        // matrix is dim x dim row-major, result receives dim * (dim + 1) / 2 packed elements
+        template <typename T>
+        bool tryCholetskyDecomposition(T const *matrix, size_t dim, T *result, size_t threads = 1)
+        {
+            packLowerTriangular(matrix, dim, result);
+            return tryCholetskyDecompositionInPlace(result, dim, threads);
+        }
+
+        template <typename T, size_t Dim>
+        bool tryCholetskyDecomposition(MatrixSq<T, Dim> const &matrix, MatrixLowerTriangular<T, Dim> &result, size_t threads = 1)
+        {
+            static_assert(sizeof(MatrixSq<T, Dim>) == sizeof(T) * Dim * Dim, "MatrixSq must be tightly packed");
+            return tryCholetskyDecomposition(matrix[0].data(), Dim, result.data(), threads);
+        }
+
+        template <typename T, size_t Dim>
+        bool tryCholetskyDecomposition(MatrixSq<T, Dim> const &matrix, MatrixSq<T, Dim> &result)
+        {
+            auto packed = std::make_unique<MatrixLowerTriangular<T, Dim>>();
+            const bool success = tryCholetskyDecomposition(matrix, *packed);
+            result = unpackLowerTriangular<T, Dim>(*packed);
+            return success;
+        }
+
+        // Replaces the packed factor L of A by the factor of A + v * v^T (update) or A - v * v^T (downdate) in O(dim^2).
+        // Row-oriented form of the rotation sequence: row i applies the rotations of all previous columns,
+        // then defines its own, so the packed rows are streamed once.
+        // A downdate is checked first (||L^-1 v|| < 1), the factor is left untouched if it would not be positive-definite.
+        template <typename T>
+        bool choletskyRankOneUpdate(T *packed, size_t dim, T const *vector, bool downdate)
+        {
+            const T sign = downdate ? T(-1) : T(1);
+
+            if (downdate)
+            {
+                // forward substitution L p = v
+                std::vector<T> solved(dim);
+                T norm = 0;
+                for (size_t i = 0; i < dim; i++)
+                {
+                    T const *row = packed + packedRowOffset(i);
+                    T sum = vector[i];
+                    for (size_t k = 0; k < i; k++)
+                    {
+                        sum -= row[k] * solved[k];
+                    }
+                    solved[i] = sum / row[i];
+                    norm += solved[i] * solved[i];
+                }
+
+                const T tolerance = std::numeric_limits<T>::epsilon() * static_cast<T>(dim);
+                if (!(T(1) - norm > tolerance))
+                {
+                    return false;
+                }
+            }
+
+            std::vector<T> cosines(dim);
+            std::vector<T> sines(dim);
+            for (size_t i = 0; i < dim; i++)
+            {
+                T *row = packed + packedRowOffset(i);
+                T w = vector[i];
+                for (size_t k = 0; k < i; k++)
+                {
+                    const T updated = (row[k] + sign * sines[k] * w) / cosines[k];
+                    w = cosines[k] * w - sines[k] * updated;
+                    row[k] = updated;
+                }
+
+                const T diagonal = row[i];
+                const T radius = std::sqrt(downdate ? (diagonal - w) * (diagonal + w) : diagonal * diagonal + w * w);
+                cosines[i] = radius / diagonal;
+                sines[i] = w / diagonal;
+                row[i] = radius;
+            }
+
+            return true;
+        }
+
+        // Replaces the packed factor of A by the factor of factor * A, factor must be positive
+        template <typename T>
+        void choletskyScale(T *packed, size_t dim, T factor)
+        {
+            const T root = std::sqrt(factor);
+            const size_t size = packedRowOffset(dim);
+            for (size_t i = 0; i < size; i++)
+            {
+                packed[i] *= root;
+            }
+        }
+
+        // Exponentially weighted update with a new observation:
+        // mean = decay * mean + (1 - decay) * value, A = decay * A + decay * (1 - decay) * (value - old mean) (value - old mean)^T
+        template <typename T>
+        void choletskyExponentialUpdate(T *packed, T *mean, size_t dim, T const *value, T decay)
+        {
+            std::vector<T> deviation(dim);
+            const T weight = std::sqrt(decay * (T(1) - decay));
+            for (size_t i = 0; i < dim; i++)
+            {
+                deviation[i] = weight * (value[i] - mean[i]);
+                mean[i] = decay * mean[i] + (T(1) - decay) * value[i];
+            }
+
+            choletskyScale(packed, dim, decay);
+            choletskyRankOneUpdate(packed, dim, deviation.data(), false);
+        }
+
+        // log det(L * L^T) = 2 * sum of log L[i][i]
+        template <typename T>
+        T choletskyLogDeterminant(T const *packed, size_t dim)
+        {
+            T sum{};
+            for (size_t i = 0; i < dim; i++)
+            {
+                sum += std::log(packed[packedRowOffset(i) + i]);
+            }
+            return 2 * sum;
+        }
+
+        // Solves L * x = b in place for a packed lower-triangular factor
+        template <typename T>
+        void choletskySolveInPlace(T const *packed, size_t dim, T *x)
+        {
+            for (size_t i = 0; i < dim; i++)
+            {
+                T const *row = packed + packedRowOffset(i);
+                T acc = x[i];
+                for (size_t k = 0; k < i; k++)
+                {
+                    acc -= row[k] * x[k];
+                }
+                x[i] = acc / row[i];
+            }
+        }
+
+        // Solves L^T * x = b in place for a packed lower-triangular factor, L^T is walked by rows of L
+        template <typename T>
+        void choletskySolveTransposedInPlace(T const *packed, size_t dim, T *x)
+        {
+            for (size_t i = dim; i-- > 0;)
+            {
+                T const *row = packed + packedRowOffset(i);
+                x[i] /= row[i];
+                for (size_t k = 0; k < i; k++)
+                {
+                    x[k] -= row[k] * x[i];
+                }
+            }
+        }
+
+        // Squared Mahalanobis distance of a single point, the same arithmetic as squaredMahalanobisDistances()
+        // without its block buffer. solved receives L^-1 (x - mean), dim values.
+        template <typename T>
+        T squaredMahalanobisDistance(T const *lower, T const *mean, size_t dim, T const *point, T *solved)
+        {
+            T distance{};
+            for (size_t i = 0; i < dim; i++)
+            {
+                T const *row = lower + packedRowOffset(i);
+                T acc = point[i] - mean[i];
+                for (size_t k = 0; k < i; k++)
+                {
+                    acc -= row[k] * solved[k];
+                }
+                solved[i] = acc / row[i];
+                distance += solved[i] * solved[i];
+            }
+            return distance;
+        }
+
+        // points scored together, the forward substitution runs over them in the innermost loop
+        constexpr size_t scoreBatchSize = 32;
+
+        // Squared Mahalanobis distances |L^-1 (x - mean)|^2 of count points stored one after another, by forward
+        // substitution against the packed factor. Points are centered into component-major blocks, so every step
+        // of the substitution is a loop over the points of the block the compiler can vectorize.
+        template <typename T>
+        void squaredMahalanobisDistances(T const *lower, T const *mean, size_t dim, T const *points, size_t count, T *out)
+        {
+            std::vector<T> block(dim * scoreBatchSize);
+
+            for (size_t first = 0; first < count; first += scoreBatchSize)
+            {
+                const size_t lanes = std::min(scoreBatchSize, count - first);
+                for (size_t lane = 0; lane < lanes; lane++)
+                {
+                    T const *point = points + (first + lane) * dim;
+                    for (size_t i = 0; i < dim; i++)
+                    {
+                        block[i * scoreBatchSize + lane] = point[i] - mean[i];
+                    }
+                }
+
+                T distances[scoreBatchSize]{};
+                for (size_t i = 0; i < dim; i++)
+                {
+                    T const *row = lower + packedRowOffset(i);
+                    T *solved = block.data() + i * scoreBatchSize;
+
+                    T acc[scoreBatchSize]{};
+                    std::copy(solved, solved + lanes, acc);
+                    for (size_t k = 0; k < i; k++)
+                    {
+                        const T coefficient = row[k];
+                        T const *previous = block.data() + k * scoreBatchSize;
+                        for (size_t lane = 0; lane < lanes; lane++)
+                        {
+                            acc[lane] -= coefficient * previous[lane];
+                        }
+                    }
+
+                    const T diagonal = row[i];
+                    for (size_t lane = 0; lane < lanes; lane++)
+                    {
+                        solved[lane] = acc[lane] / diagonal;
+                        distances[lane] += solved[lane] * solved[lane];
+                    }
+                }
+
+                std::copy(distances, distances + lanes, out + first);
+            }
+        }
+
+        // log N(x | mean, L * L^T) of count points from their squared Mahalanobis distances, in place
+        template <typename T>
+        void logPdfFromSquaredDistances(T logDeterminant, size_t dim, T *values, size_t count)
+        {
+            constexpr T logTwoPi = static_cast<T>(1.83787706640934548356);
+            const T normalization = static_cast<T>(dim) * logTwoPi + logDeterminant;
+            for (size_t i = 0; i < count; i++)
+            {
+                values[i] = -(normalization + values[i]) / 2;
+            }
+        }
+
+        template <typename T>
+        void mahalanobisFromSquaredDistances(T *values, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                values[i] = std::sqrt(values[i]);
+            }
+        }
+
+        template <typename T, size_t Dim>
+        MatrixSq<T, Dim> doCholetskyDecomposition(MatrixSq<T, Dim> const &matrix)
+        {
+            MatrixSq<T, Dim> result{};
+            tryCholetskyDecomposition(matrix, result);
+            return result;
+        }
+
+        template <typename T, size_t Dim>
+        valueVector<T, Dim> multiplyMatrixByVector(MatrixSq<T, Dim> const &matrix, valueVector<T, Dim> const &vector)
+        {
+            valueVector<T, Dim> result{};
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                result[i] = vectorDotProduct(matrix[i], vector);
+            }
+
+            return result;
+        }
+
+        template <typename T, size_t Dim>
+        valueVector<T, Dim> multiplyLowerTriangularByVector(MatrixLowerTriangular<T, Dim> const &lower, valueVector<T, Dim> const &vector)
+        {
+            valueVector<T, Dim> result{};
+            for (size_t i = 0; i < Dim; i++)
+            {
+                T const *row = lower.data() + packedRowOffset(i);
+                for (size_t j = 0; j <= i; j++)
+                {
+                    result[i] += row[j] * vector[j];
+                }
+            }
+
+            return result;
+        }
+
+        // Replaces each of the count vectors z stored contiguously in values with lower * z + mean.
+        // The factor is in packed lower-triangular form. Rows are processed bottom-up, so row i only reads z[0..i] that are not yet overwritten
+        // and no scratch buffer is needed. Samples are walked in blocks that stay in L1, and every
+        // row of the factor is applied to four samples at once (a blocked L * Z product).
+        // The per-element summation order does not depend on count, so the batch and
+        // single-vector paths produce bit-identical results.
+        template <typename T>
+        void transformStandardNormalVectors(T const *lower, T const *mean, size_t dim, T *values, size_t count)
+        {
+            constexpr size_t blockBytes = 32 * 1024;
+            const size_t samplesPerBlock = std::max<size_t>(4, blockBytes / (sizeof(T) * dim));
+
+            for (size_t first = 0; first < count; first += samplesPerBlock)
+            {
+                const size_t last = std::min(count, first + samplesPerBlock);
+
+                for (size_t row = dim; row-- > 0;)
+                {
+                    T const *coefficients = lower + packedRowOffset(row);
+
+                    size_t sample = first;
+                    for (; sample + 4 <= last; sample += 4)
+                    {
+                        T *v0 = values + sample * dim;
+                        T *v1 = v0 + dim;
+                        T *v2 = v1 + dim;
+                        T *v3 = v2 + dim;
+
+                        T acc0{}, acc1{}, acc2{}, acc3{};
+                        for (size_t k = 0; k <= row; k++)
+                        {
+                            acc0 += coefficients[k] * v0[k];
+                            acc1 += coefficients[k] * v1[k];
+                            acc2 += coefficients[k] * v2[k];
+                            acc3 += coefficients[k] * v3[k];
+                        }
+
+                        v0[row] = acc0 + mean[row];
+                        v1[row] = acc1 + mean[row];
+                        v2[row] = acc2 + mean[row];
+                        v3[row] = acc3 + mean[row];
+                    }
+
+                    for (; sample < last; sample++)
+                    {
+                        T *v = values + sample * dim;
+
+                        T acc{};
+                        for (size_t k = 0; k <= row; k++)
+                        {
+                            acc += coefficients[k] * v[k];
+                        }
+
+                        v[row] = acc + mean[row];
+                    }
+                }
+            }
+        }
+
+        template <typename T, size_t Dim>
+        void transformStandardNormalVectors(MatrixLowerTriangular<T, Dim> const &lower, valueVector<T, Dim> const &mean, T *values, size_t count)
+        {
+            transformStandardNormalVectors(lower.data(), mean.data(), Dim, values, count);
+        }
+
+        // Portable standard normal sampler.
+        //
+        // std::normal_distribution differs between standard library implementations and draws one value
+        // at a time. This is the Marsaglia-Tsang ziggurat with 128 layers (the ZIGNOR variant by Doornik),
+        // fed with 64-bit words built from the engine output. Each word gives the layer (bits 0-6),
+        // the sign (bit 7) and a uniform value (bits 12-63) that is built exactly through the bit pattern.
+        // The fast path, taken ~99% of the time, is a table lookup and a single multiplication, so it is
+        // bit-reproducible on every IEEE-754 platform and is evaluated with AVX-512/AVX2 when available.
+        // The rare wedge and tail cases use our own exp/log implementations instead of the libm ones.
+        //
+        // Words are drawn in chunks of normalChunkSize, the fast path is run over the whole chunk and
+        // rejected lanes are then resolved in lane order, drawing further words as needed. SIMD and scalar
+        // kernels evaluate exactly the same expressions, so the engine is consumed in the same order
+        // and the output is the same whichever one was compiled in.
+
+        constexpr size_t zigguratLayers = 128;
+        constexpr size_t normalChunkSize = 64;
+        constexpr double zigguratTailStart = 3.442619855899;
+        constexpr double zigguratLayerArea = 9.91256303526217e-3;
+
+        constexpr double ln2Hi = 6.93147180369123816490e-01; // trailing zeros make n * ln2Hi exact
+        constexpr double ln2Lo = 1.90821492927058770002e-10;
+
+        // exp(x) through range reduction and a Taylor polynomial, accurate to a few ulp
+        MNV_NO_FP_CONTRACT inline double portableExp(double x)
+        {
+            if (x < -745.0)
+            {
+                return 0;
+            }
+
+            const double n = std::floor(x * 1.44269504088896338700 + 0.5);
+            const double nLn2Hi = n * ln2Hi;
+            const double nLn2Lo = n * ln2Lo;
+            const double r = (x - nLn2Hi) - nLn2Lo; // |r| <= ln2 / 2
+
+            double poly = 1.0 / 6227020800.0; // 1/13!
+            const double inverseFactorials[] = {
+                1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+                1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0,
+                1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0};
+            for (double c : inverseFactorials)
+            {
+                poly = poly * r;
+                poly = poly + c;
+            }
+
+            return std::ldexp(poly, static_cast<int>(n));
+        }
+
+        // log(x) for finite positive x through the atanh series, accurate to a few ulp
+        MNV_NO_FP_CONTRACT inline double portableLog(double x)
+        {
+            int exponent = 0;
+            double mantissa = std::frexp(x, &exponent); // [0.5, 1)
+            if (mantissa < 0.70710678118654752440)
+            {
+                mantissa *= 2;
+                exponent--;
+            }
+
+            const double s = (mantissa - 1) / (mantissa + 1); // |s| <= 0.1716
+            const double s2 = s * s;
+
+            double poly = 1.0 / 25.0;
+            const double inverseOdds[] = {
+                1.0 / 23.0, 1.0 / 21.0, 1.0 / 19.0, 1.0 / 17.0, 1.0 / 15.0, 1.0 / 13.0,
+                1.0 / 11.0, 1.0 / 9.0, 1.0 / 7.0, 1.0 / 5.0, 1.0 / 3.0, 1.0};
+            for (double c : inverseOdds)
+            {
+                poly = poly * s2;
+                poly = poly + c;
+            }
+
+            const double e = static_cast<double>(exponent);
+            const double eLn2Hi = e * ln2Hi;
+            const double eLn2Lo = e * ln2Lo;
+            const double series = 2 * s * poly;
+            return eLn2Hi + (series + eLn2Lo);
+        }
+
+        struct ZigguratTables
+        {
+            // right edges of the layers, layerEdge[0] is the pseudo-edge of the base layer
+            alignas(64) double layerEdge[zigguratLayers + 1];
+            // layerEdge[i + 1] / layerEdge[i], values below are inside the layer's rectangle
+            alignas(64) double layerRatio[zigguratLayers];
+        };
+
+        MNV_NO_FP_CONTRACT inline ZigguratTables makeZigguratTables()
+        {
+            ZigguratTables tables{};
+
+            double f = portableExp(-0.5 * (zigguratTailStart * zigguratTailStart));
+            tables.layerEdge[0] = zigguratLayerArea / f;
+            tables.layerEdge[1] = zigguratTailStart;
+            for (size_t i = 2; i < zigguratLayers; i++)
+            {
+                tables.layerEdge[i] = std::sqrt(-2 * portableLog(zigguratLayerArea / tables.layerEdge[i - 1] + f));
+                f = portableExp(-0.5 * (tables.layerEdge[i] * tables.layerEdge[i]));
+            }
+            tables.layerEdge[zigguratLayers] = 0;
+
+            for (size_t i = 0; i < zigguratLayers; i++)
+            {
+                tables.layerRatio[i] = tables.layerEdge[i + 1] / tables.layerEdge[i];
+            }
+
+            return tables;
+        }
+
+        inline ZigguratTables const &zigguratTables()
+        {
+            static const ZigguratTables tables = makeZigguratTables();
+            return tables;
+        }
+
+        // Engines must produce full 32-bit or 64-bit words, two 32-bit words are combined high first
+        template <typename Engine>
+        std::uint64_t nextRandomBits(Engine &engine)
+        {
+            static_assert(Engine::min() == 0 &&
+                              (Engine::max() == 0xFFFFFFFFu || Engine::max() == std::numeric_limits<std::uint64_t>::max()),
+                          "The engine has to produce uniformly distributed 32-bit or 64-bit words");
+
+            if constexpr (Engine::max() == 0xFFFFFFFFu)
+            {
+                const std::uint64_t high = static_cast<std::uint64_t>(engine()) & 0xFFFFFFFFu;
+                const std::uint64_t low = static_cast<std::uint64_t>(engine()) & 0xFFFFFFFFu;
+                return (high << 32) | low;
+            }
+            else
+            {
+                return static_cast<std::uint64_t>(engine());
+            }
+        }
+
+        // uniform value in [0, 1) from the upper 52 bits, exact: the bits become the mantissa of [1, 2)
+        inline double uniformFromBits(std::uint64_t bits)
+        {
+            const std::uint64_t pattern = (bits >> 12) | 0x3FF0000000000000u;
+            double result = 0;
+            std::memcpy(&result, &pattern, sizeof(result));
+            return result - 1.0;
+        }
+
+        inline double applySignBit(double value, std::uint64_t bits)
+        {
+            std::uint64_t pattern = 0;
+            std::memcpy(&pattern, &value, sizeof(value));
+            pattern ^= ((bits >> 7) & 1) << 63;
+            std::memcpy(&value, &pattern, sizeof(value));
+            return value;
+        }
+
+        // Fast path for count <= 64 lanes. Every lane gets u * edge with the sign applied,
+        // lanes that fall outside their layer's rectangle are marked in the returned mask.
+        inline std::uint64_t zigguratFastPathScalar(ZigguratTables const &tables, std::uint64_t const *bits, double *out, size_t count)
+        {
+            std::uint64_t rejected = 0;
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                const size_t layer = static_cast<size_t>(bits[lane] & (zigguratLayers - 1));
+                const double u = uniformFromBits(bits[lane]);
+                out[lane] = applySignBit(u * tables.layerEdge[layer], bits[lane]);
+                if (!(u < tables.layerRatio[layer]))
+                {
+                    rejected |= std::uint64_t{1} << lane;
+                }
+            }
+
+            return rejected;
+        }
+
+#if defined(MNV_SIMD_AVX512)
+        inline std::uint64_t zigguratFastPath(ZigguratTables const &tables, std::uint64_t const *bits, double *out, size_t count)
+        {
+            const __m512i layerMask = _mm512_set1_epi64(static_cast<long long>(zigguratLayers - 1));
+            const __m512i exponentOne = _mm512_set1_epi64(0x3FF0000000000000);
+            const __m512d one = _mm512_set1_pd(1.0);
+
+            std::uint64_t rejected = 0;
+            size_t lane = 0;
+            for (; lane + 8 <= count; lane += 8)
+            {
+                const __m512i word = _mm512_loadu_si512(bits + lane);
+                const __m512i layer = _mm512_and_si512(word, layerMask);
+                const __m512d u = _mm512_sub_pd(
+                    _mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(word, 12), exponentOne)), one);
+                const __m512d edge = _mm512_i64gather_pd(layer, tables.layerEdge, 8);
+                const __m512d ratio = _mm512_i64gather_pd(layer, tables.layerRatio, 8);
+                const __m512i sign = _mm512_slli_epi64(_mm512_srli_epi64(word, 7), 63);
+                const __m512i value = _mm512_xor_si512(_mm512_castpd_si512(_mm512_mul_pd(u, edge)), sign);
+                _mm512_storeu_pd(out + lane, _mm512_castsi512_pd(value));
+
+                const __mmask8 accepted = _mm512_cmp_pd_mask(u, ratio, _CMP_LT_OQ);
+                rejected |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(~accepted)) << lane;
+            }
+
+            return rejected | (zigguratFastPathScalar(tables, bits + lane, out + lane, count - lane) << lane);
+        }
+#elif defined(MNV_SIMD_AVX2)
+        inline std::uint64_t zigguratFastPath(ZigguratTables const &tables, std::uint64_t const *bits, double *out, size_t count)
+        {
+            const __m256i layerMask = _mm256_set1_epi64x(static_cast<long long>(zigguratLayers - 1));
+            const __m256i exponentOne = _mm256_set1_epi64x(0x3FF0000000000000);
+            const __m256d one = _mm256_set1_pd(1.0);
+
+            std::uint64_t rejected = 0;
+            size_t lane = 0;
+            for (; lane + 4 <= count; lane += 4)
+            {
+                const __m256i word = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(bits + lane));
+                const __m256i layer = _mm256_and_si256(word, layerMask);
+                const __m256d u = _mm256_sub_pd(
+                    _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(word, 12), exponentOne)), one);
+                const __m256d edge = _mm256_i64gather_pd(tables.layerEdge, layer, 8);
+                const __m256d ratio = _mm256_i64gather_pd(tables.layerRatio, layer, 8);
+                const __m256i sign = _mm256_slli_epi64(_mm256_srli_epi64(word, 7), 63);
+                const __m256d value = _mm256_xor_pd(_mm256_mul_pd(u, edge), _mm256_castsi256_pd(sign));
+                _mm256_storeu_pd(out + lane, value);
+
+                const int accepted = _mm256_movemask_pd(_mm256_cmp_pd(u, ratio, _CMP_LT_OQ));
+                rejected |= static_cast<std::uint64_t>(~accepted & 0xF) << lane;
+            }
+
+            return rejected | (zigguratFastPathScalar(tables, bits + lane, out + lane, count - lane) << lane);
+        }
+#else
+        inline std::uint64_t zigguratFastPath(ZigguratTables const &tables, std::uint64_t const *bits, double *out, size_t count)
+        {
+            return zigguratFastPathScalar(tables, bits, out, count);
+        }
+#endif
+
+        // Resolves a lane rejected by the fast path, starting from the word it was given
+        template <typename Engine>
+        MNV_NO_FP_CONTRACT double zigguratSlowPath(ZigguratTables const &tables, Engine &engine, std::uint64_t bits)
+        {
+            for (;;)
+            {
+                const size_t layer = static_cast<size_t>(bits & (zigguratLayers - 1));
+                const double u = uniformFromBits(bits);
+
+                if (u < tables.layerRatio[layer])
+                {
+                    return applySignBit(u * tables.layerEdge[layer], bits);
+                }
+
+                if (layer == 0)
+                {
+                    // tail beyond zigguratTailStart, Marsaglia's method. 1 - uniform is in (0, 1]
+                    double x = 0;
+                    double y = 0;
+                    do
+                    {
+                        x = -portableLog(1.0 - uniformFromBits(nextRandomBits(engine))) / zigguratTailStart;
+                        y = -portableLog(1.0 - uniformFromBits(nextRandomBits(engine)));
+                    } while (y + y < x * x); // single rounded product compared, nothing to fuse
+
+                    return applySignBit(zigguratTailStart + x, bits);
+                }
+
+                // wedge between the layer's rectangle and the density
+                const double x = u * tables.layerEdge[layer];
+                const double xSquared = x * x;
+                const double outerSquared = tables.layerEdge[layer] * tables.layerEdge[layer];
+                const double innerSquared = tables.layerEdge[layer + 1] * tables.layerEdge[layer + 1];
+                const double fOuter = portableExp(-0.5 * (outerSquared - xSquared));
+                const double fInner = portableExp(-0.5 * (innerSquared - xSquared));
+                const double offset = uniformFromBits(nextRandomBits(engine)) * (fOuter - fInner);
+                if (fInner + offset < 1.0)
+                {
+                    return applySignBit(x, bits);
+                }
+
+                bits = nextRandomBits(engine);
+            }
+        }
+
+        // Fills out with count independent N(0, 1) values
+        template <typename T, typename Engine>
+        void fillStandardNormal(Engine &engine, T *out, size_t count)
+        {
+            ZigguratTables const &tables = zigguratTables();
+
+            std::uint64_t bits[normalChunkSize];
+            double values[normalChunkSize];
+
+            for (size_t first = 0; first < count; first += normalChunkSize)
+            {
+                const size_t chunk = std::min(normalChunkSize, count - first);
+
+                for (size_t lane = 0; lane < chunk; lane++)
+                {
+                    bits[lane] = nextRandomBits(engine);
+                }
+
+                const std::uint64_t rejected = zigguratFastPath(tables, bits, values, chunk);
+
+                for (size_t lane = 0; lane < chunk; lane++)
+                {
+                    if ((rejected >> lane) & 1)
+                    {
+                        values[lane] = zigguratSlowPath(tables, engine, bits[lane]);
+                    }
+                    out[first + lane] = static_cast<T>(values[lane]);
+                }
+            }
+        }
+
+        // Draws count values of the distribution with the given engine into out
+        template <typename T, typename Engine>
+        void generateValues(Engine &engine, T const *lower, T const *mean, size_t dim, T *out, size_t count)
+        {
+            // drawn per value, so the engine is consumed the same way as by a single value
+            for (size_t i = 0; i < count; i++)
+            {
+                fillStandardNormal(engine, out + i * dim, dim);
+            }
+
+            transformStandardNormalVectors(lower, mean, dim, out, count);
+        }
+
+        // Draws count values as antithetic pairs mean + L z, mean - L z: one set of normals and one
+        // transform serve both values of a pair. An odd count ends with the first value of a pair.
+        template <typename T, typename Engine>
+        void generateAntitheticValues(Engine &engine, T const *lower, T const *mean, size_t dim, T *out, size_t count)
+        {
+            const size_t pairs = (count + 1) / 2;
+            for (size_t i = 0; i < pairs; i++)
+            {
+                fillStandardNormal(engine, out + i * dim, dim);
+            }
+
+            // L z of every pair is kept in the first half of out
+            const std::vector<T> zero(dim);
+            transformStandardNormalVectors(lower, zero.data(), dim, out, pairs);
+
+            // back to front, slot i is read before slots 2i and 2i + 1 are written and no unread slot is touched
+            for (size_t i = pairs; i-- > 0;)
+            {
+                T *first = out + 2 * i * dim;
+                T *second = first + dim;
+                const bool hasSecond = 2 * i + 1 < count;
+                for (size_t j = 0; j < dim; j++)
+                {
+                    const T value = out[i * dim + j];
+                    first[j] = mean[j] + value;
+                    if (hasSecond)
+                    {
+                        second[j] = mean[j] - value;
+                    }
+                }
+            }
+        }
+
+        // Draws count values whose sample mean is mean and whose sample covariance (divided by count - 1)
+        // is lower * lower^T, exact up to rounding. The normals z are centered, then transformed by
+        // lower * C^-1 in one pass, where C is the Choletsky factor of their own sample covariance.
+        // Statistics are accumulated in double. false if count <= dim or the normals are degenerate.
+        template <typename T, typename Engine>
+        bool generateMomentMatchedValues(Engine &engine, T const *lower, T const *mean, size_t dim, T *out, size_t count)
+        {
+            if (count <= dim)
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                fillStandardNormal(engine, out + i * dim, dim);
+            }
+
+            // 1. center the normals
+            std::vector<double> sampleMean(dim);
+            for (size_t i = 0; i < count; i++)
+            {
+                for (size_t j = 0; j < dim; j++)
+                {
+                    sampleMean[j] += static_cast<double>(out[i * dim + j]);
+                }
+            }
+            for (size_t j = 0; j < dim; j++)
+            {
+                sampleMean[j] /= static_cast<double>(count);
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                for (size_t j = 0; j < dim; j++)
+                {
+                    out[i * dim + j] = static_cast<T>(static_cast<double>(out[i * dim + j]) - sampleMean[j]);
+                }
+            }
+
+            // 2. their sample covariance and its factor C, packed lower triangle
+            std::vector<double> factor(packedRowOffset(dim));
+            for (size_t s = 0; s < count; s++)
+            {
+                T const *z = out + s * dim;
+                for (size_t i = 0; i < dim; i++)
+                {
+                    double *row = factor.data() + packedRowOffset(i);
+                    const double zi = static_cast<double>(z[i]);
+                    for (size_t j = 0; j <= i; j++)
+                    {
+                        row[j] += zi * static_cast<double>(z[j]);
+                    }
+                }
+            }
+            for (double &value : factor)
+            {
+                value /= static_cast<double>(count - 1);
+            }
+            if (!tryCholetskyDecompositionInPlace(factor.data(), dim))
+            {
+                return false;
+            }
+
+            // 3. C^-1, lower-triangular, column by column
+            std::vector<double> inverse(packedRowOffset(dim));
+            for (size_t j = 0; j < dim; j++)
+            {
+                inverse[packedRowOffset(j) + j] = 1 / factor[packedRowOffset(j) + j];
+                for (size_t i = j + 1; i < dim; i++)
+                {
+                    double sum = 0;
+                    for (size_t k = j; k < i; k++)
+                    {
+                        sum += factor[packedRowOffset(i) + k] * inverse[packedRowOffset(k) + j];
+                    }
+                    inverse[packedRowOffset(i) + j] = -sum / factor[packedRowOffset(i) + i];
+                }
+            }
+
+            // 4. lower * C^-1 is lower-triangular as well, so the usual transform applies it
+            std::vector<T> whitened(packedRowOffset(dim));
+            for (size_t i = 0; i < dim; i++)
+            {
+                for (size_t j = 0; j <= i; j++)
+                {
+                    double sum = 0;
+                    for (size_t k = j; k <= i; k++)
+                    {
+                        sum += static_cast<double>(lower[packedRowOffset(i) + k]) * inverse[packedRowOffset(k) + j];
+                    }
+                    whitened[packedRowOffset(i) + j] = static_cast<T>(sum);
+                }
+            }
+
+            transformStandardNormalVectors(whitened.data(), mean, dim, out, count);
+            return true;
+        }
+
+        // N(0, 1) truncated to [a, b], a < b, either may be infinite. Rejection with the proposal that suits the
+        // interval (Robert, 1995): normals or uniforms if it holds the mode, a shifted exponential for a tail and
+        // uniforms for a short interval off the mode. Every case accepts more than about half of the proposals.
+        template <typename Engine>
+        double truncatedStandardNormal(Engine &engine, double a, double b)
+        {
+            if (b <= 0)
+            {
+                return -truncatedStandardNormal(engine, -b, -a);
+            }
+
+            if (a < 0)
+            {
+                if (b - a >= 2.5066282746310002) // sqrt(2 pi)
+                {
+                    for (;;)
+                    {
+                        double x = 0;
+                        fillStandardNormal(engine, &x, 1);
+                        if (a <= x && x <= b)
+                        {
+                            return x;
+                        }
+                    }
+                }
+
+                for (;;)
+                {
+                    const double x = a + (b - a) * uniformFromBits(nextRandomBits(engine));
+                    if (uniformFromBits(nextRandomBits(engine)) <= portableExp(-0.5 * x * x))
+                    {
+                        return x;
+                    }
+                }
+            }
+
+            // right tail [a, b], a >= 0: the exponential rate that maximizes the acceptance
+            const double root = std::sqrt(a * a + 4);
+            const double rate = 0.5 * (a + root);
+            if (b - a < 2 / (a + root) * portableExp(0.25 * (a * a - a * root) + 0.5))
+            {
+                for (;;)
+                {
+                    const double x = a + (b - a) * uniformFromBits(nextRandomBits(engine));
+                    if (uniformFromBits(nextRandomBits(engine)) <= portableExp(0.5 * (a * a - x * x)))
+                    {
+                        return x;
+                    }
+                }
+            }
+
+            for (;;)
+            {
+                const double x = a - portableLog(1.0 - uniformFromBits(nextRandomBits(engine))) / rate;
+                if (x <= b && uniformFromBits(nextRandomBits(engine)) <= portableExp(-0.5 * (x - rate) * (x - rate)))
+                {
+                    return x;
+                }
+            }
+        }
+
+        // One Gibbs sweep over the whitened coordinates z of x = mean + lower * z restricted to the box
+        // [lowerBounds, upperBounds]. Given the other coordinates, z_j is N(0, 1) truncated to the intersection of the
+        // intervals rows i >= j allow, the rows whose value depends on z_j. shifted holds lower * z and is updated
+        // along, so a sweep costs about as much as one transform.
+        template <typename T, typename Engine>
+        void truncatedGibbsSweep(Engine &engine, T const *lower, T const *mean, T const *lowerBounds, T const *upperBounds,
+                                 size_t dim, double *z, double *shifted)
+        {
+            for (size_t j = 0; j < dim; j++)
+            {
+                double from = -std::numeric_limits<double>::infinity();
+                double to = std::numeric_limits<double>::infinity();
+                for (size_t i = j; i < dim; i++)
+                {
+                    const double l = lower[packedRowOffset(i) + j];
+                    if (l == 0)
+                    {
+                        continue;
+                    }
+                    const double rest = static_cast<double>(mean[i]) + shifted[i] - l * z[j];
+                    double low = (static_cast<double>(lowerBounds[i]) - rest) / l;
+                    double high = (static_cast<double>(upperBounds[i]) - rest) / l;
+                    if (l < 0)
+                    {
+                        std::swap(low, high);
+                    }
+                    from = std::max(from, low);
+                    to = std::min(to, high);
+                }
+
+                // the interval holds z_j, unless rounding has closed it: then z_j stays
+                if (!(from < to))
+                {
+                    continue;
+                }
+
+                const double delta = truncatedStandardNormal(engine, from, to) - z[j];
+                z[j] += delta;
+                for (size_t i = j; i < dim; i++)
+                {
+                    shifted[i] += lower[packedRowOffset(i) + j] * delta;
+                }
+            }
+        }
+
+        constexpr size_t cacheLineSize = 64;
+
+        // Values generated in parallel are split into chunks of this size, each with its own substream.
+        // The split does not depend on the thread count, so neither does the output.
+        constexpr size_t parallelChunkSize = 1024;
+
+        template <typename Engine, typename = void>
+        struct hasStreamSelection : std::false_type
+        {
+        };
+
+        template <typename Engine>
+        struct hasStreamSelection<Engine, std::void_t<decltype(std::declval<Engine &>().stream(std::uint64_t{}))>>
+            : std::true_type
+        {
+        };
+
+        // splitmix64 finalizer
+        inline std::uint64_t mixBits(std::uint64_t x)
+        {
+            x += 0x9E3779B97F4A7C15u;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9u;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBu;
+            return x ^ (x >> 31);
+        }
+
+        // Engine for an independent substream of the given seed.
+        // Counter-based engines just select a stream under a key derived from the seed (so the substreams
+        // never overlap with the engine seeded directly), others are initialized through std::seed_seq.
+        template <typename Engine>
+        Engine makeSubstreamEngine(std::uint64_t seed, std::uint64_t substream)
+        {
+            if constexpr (hasStreamSelection<Engine>::value)
+            {
+                Engine engine{};
+                engine.seed(mixBits(seed));
+                engine.stream(substream);
+                return engine;
+            }
+            else
+            {
+                std::seed_seq sequence{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                                       static_cast<std::uint32_t>(substream), static_cast<std::uint32_t>(substream >> 32)};
+                return Engine(sequence);
+            }
+        }
+
+        // Fills count values split into chunks drawn from substreams firstSubstream, firstSubstream + 1, ...
+        template <typename T, typename Engine>
+        void generateValuesParallel(std::uint64_t seed, std::uint64_t firstSubstream, T const *lower, T const *mean, size_t dim,
+                                    T *out, size_t count, size_t threads)
+        {
+            const size_t chunks = (count + parallelChunkSize - 1) / parallelChunkSize;
+
+            runParallel(chunks, threads, [&](size_t chunk)
+                        {
+                Engine engine = makeSubstreamEngine<Engine>(seed, firstSubstream + chunk);
+                const size_t first = chunk * parallelChunkSize;
+                const size_t chunkSize = std::min(parallelChunkSize, count - first);
+                generateValues(engine, lower, mean, dim, out + first * dim, chunkSize); });
+        }
+
+        // samples per block of the covariance estimation, a centered block stays in L1/L2 while it is consumed
+        constexpr size_t covarianceBlockRows = 64;
+
+        // Adds sum of (x - mean) (x - mean)^T over samples [first, last) to the packed lower triangle accumulator.
+        // Samples are centered block by block, then every accumulator row is updated from the whole block
+        // while it stays in cache (rank-k update, only the lower triangle is touched).
+        template <typename T, size_t Dim>
+        void accumulateCenteredProducts(valueVector<T, Dim> const *samples, valueVector<T, Dim> const &mean,
+                                        size_t first, size_t last, T *accumulator)
+        {
+            std::vector<T> centered(covarianceBlockRows * Dim);
+
+            for (size_t blockStart = first; blockStart < last; blockStart += covarianceBlockRows)
+            {
+                const size_t rows = std::min(covarianceBlockRows, last - blockStart);
+                for (size_t k = 0; k < rows; k++)
+                {
+                    T *row = centered.data() + k * Dim;
+                    for (size_t i = 0; i < Dim; i++)
+                    {
+                        row[i] = samples[blockStart + k][i] - mean[i];
+                    }
+                }
+
+                for (size_t i = 0; i < Dim; i++)
+                {
+                    T *out = accumulator + packedRowOffset(i);
+                    for (size_t k = 0; k < rows; k++)
+                    {
+                        T const *row = centered.data() + k * Dim;
+                        const T factor = row[i];
+                        for (size_t j = 0; j <= i; j++)
+                        {
+                            out[j] += factor * row[j];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Heap buffer aligned to the cache line, elements are value-initialized
+        template <typename T>
+        struct AlignedDeleter
+        {
+            void operator()(T *pointer) const
+            {
+                ::operator delete(pointer, std::align_val_t{cacheLineSize});
+            }
+        };
+
+        template <typename T>
+        using AlignedBuffer = std::unique_ptr<T[], AlignedDeleter<T>>;
+
+        template <typename T>
+        AlignedBuffer<T> makeAlignedBuffer(size_t size)
+        {
+            static_assert(std::is_trivial_v<T>, "Only trivial types can be stored in aligned buffers");
+            T *pointer = static_cast<T *>(::operator new(std::max<size_t>(1, size) * sizeof(T), std::align_val_t{cacheLineSize}));
+            std::fill(pointer, pointer + size, T{});
+            return AlignedBuffer<T>(pointer);
+        }
+
+        // rounds size up, so that an array of T following it starts on a cache line
+        template <typename T>
+        constexpr size_t alignedSize(size_t size)
+        {
+            constexpr size_t perLine = std::max<size_t>(1, cacheLineSize / sizeof(T));
+            return (size + perLine - 1) / perLine * perLine;
+        }
+
+        // Generator snapshots, the layout is described at SnapshotFile
+        constexpr char snapshotMagic[8] = {'M', 'N', 'V', 'S', 'N', 'A', 'P', '\0'};
+        constexpr std::uint32_t snapshotVersion = 1;
+        constexpr std::uint64_t snapshotByteOrderMark = 0x0102030405060708u;
+
+        struct SnapshotHeader
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t scalarSize;
+            std::uint64_t byteOrderMark;
+            std::uint64_t dim;
+            std::uint64_t seed;
+            std::uint64_t nextSubstream; // generateParallel() position
+            std::uint64_t engineStateSize;
+            std::uint64_t reserved;
+        };
+        static_assert(sizeof(SnapshotHeader) == cacheLineSize, "The factor must start on a cache line");
+
+        inline MNVGeneratorBuildError snapshotIsNotValid()
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::SnapshotIsNotValid,
+                ERRMSG("The snapshot is damaged, or was written by another version, for another value type or byte order\n")};
+        }
+
+        // elements of the factor and the mean, each padded to a cache line, the same as DynamicMNVGenerator storage
+        template <typename T>
+        size_t snapshotStorageSize(size_t dim)
+        {
+            return alignedSize<T>(alignedSize<T>(packedRowOffset(dim)) + dim);
+        }
+
+        template <typename T, typename Engine>
+        void writeSnapshot(std::ostream &out, T const *lower, T const *mean, size_t dim,
+                           size_t seed, std::uint64_t nextSubstream, Engine const &engine)
+        {
+            std::ostringstream engineState{};
+            engineState << engine;
+            const std::string state = engineState.str();
+
+            SnapshotHeader header{};
+            std::copy(std::begin(snapshotMagic), std::end(snapshotMagic), header.magic);
+            header.version = snapshotVersion;
+            header.scalarSize = sizeof(T);
+            header.byteOrderMark = snapshotByteOrderMark;
+            header.dim = dim;
+            header.seed = seed;
+            header.nextSubstream = nextSubstream;
+            header.engineStateSize = state.size();
+
+            const char padding[cacheLineSize]{};
+            const size_t factorSize = packedRowOffset(dim);
+            const size_t meanOffset = alignedSize<T>(factorSize);
+
+            out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+            out.write(reinterpret_cast<char const *>(lower), static_cast<std::streamsize>(factorSize * sizeof(T)));
+            out.write(padding, static_cast<std::streamsize>((meanOffset - factorSize) * sizeof(T)));
+            out.write(reinterpret_cast<char const *>(mean), static_cast<std::streamsize>(dim * sizeof(T)));
+            out.write(padding, static_cast<std::streamsize>((snapshotStorageSize<T>(dim) - meanOffset - dim) * sizeof(T)));
+            out.write(state.data(), static_cast<std::streamsize>(state.size()));
+        }
+
+        // Checks the header, the sizes and the factor diagonal of a snapshot.
+        // The storage follows the header, the engine state follows the storage.
+        template <typename T>
+        bool readSnapshotHeader(void const *data, size_t size, SnapshotHeader &header)
+        {
+            if (data == nullptr || size < sizeof(SnapshotHeader))
+            {
+                return false;
+            }
+            std::memcpy(&header, data, sizeof(header));
+
+            if (!std::equal(std::begin(snapshotMagic), std::end(snapshotMagic), header.magic) ||
+                header.version != snapshotVersion || header.scalarSize != sizeof(T) ||
+                header.byteOrderMark != snapshotByteOrderMark || header.dim == 0 || header.dim > size / sizeof(T))
+            {
+                return false;
+            }
+
+            const size_t dim = static_cast<size_t>(header.dim);
+            const size_t storageBytes = snapshotStorageSize<T>(dim) * sizeof(T);
+            const size_t available = size - sizeof(SnapshotHeader);
+            if (available < storageBytes || available - storageBytes < header.engineStateSize)
+            {
+                return false;
+            }
+
+            // a damaged factor would silently produce garbage
+            unsigned char const *storage = static_cast<unsigned char const *>(data) + sizeof(SnapshotHeader);
+            for (size_t i = 0; i < dim; i++)
+            {
+                T diagonal{};
+                std::memcpy(&diagonal, storage + (packedRowOffset(i) + i) * sizeof(T), sizeof(T));
+                if (!(diagonal > 0) || !std::isfinite(diagonal))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        template <typename Engine>
+        bool readSnapshotEngine(void const *data, SnapshotHeader const &header, size_t storageSize, Engine &engine)
+        {
+            char const *state = static_cast<char const *>(data) + sizeof(SnapshotHeader) + storageSize;
+            std::istringstream in(std::string(state, static_cast<size_t>(header.engineStateSize)));
+            in >> engine;
+
+            // anything but trailing whitespace means the state is damaged
+            return !in.fail() && (in.eof() || (in >> std::ws).eof());
+        }
+    } // namespace internal
+
+    namespace internal
+    {
+        constexpr std::uint32_t philoxMultiplier0 = 0xD2511F53u;
+        constexpr std::uint32_t philoxMultiplier1 = 0xCD9E8D57u;
+        constexpr std::uint32_t philoxWeyl0 = 0x9E3779B9u;
+        constexpr std::uint32_t philoxWeyl1 = 0xBB67AE85u;
+        constexpr size_t philoxRounds = 10;
+
+        // Philox4x32 bijection of counter under key
+        inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+        {
+            for (size_t round = 0; round < philoxRounds; round++)
+            {
+                const std::uint64_t product0 = static_cast<std::uint64_t>(philoxMultiplier0) * counter[0];
+                const std::uint64_t product1 = static_cast<std::uint64_t>(philoxMultiplier1) * counter[2];
+
+                counter = {static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                           static_cast<std::uint32_t>(product1),
+                           static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                           static_cast<std::uint32_t>(product0)};
+
+                key[0] += philoxWeyl0;
+                key[1] += philoxWeyl1;
+            }
+
+            return counter;
+        }
+    } // namespace internal
+
+    namespace internal
+    {
+        // Checks the CSR structure itself: offsets are monotonic and every column is within the matrix
+        template <typename T>
+        bool isSparseMatrixValid(SparseMatrix<T> const &matrix)
+        {
+            if (matrix.dim == 0 || matrix.rowOffsets.size() != matrix.dim + 1 || matrix.rowOffsets[0] != 0 ||
+                matrix.columns.size() != matrix.rowOffsets[matrix.dim] || matrix.values.size() != matrix.columns.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < matrix.dim; i++)
+            {
+                if (matrix.rowOffsets[i] > matrix.rowOffsets[i + 1])
+                {
+                    return false;
+                }
+            }
+
+            return std::all_of(matrix.columns.begin(), matrix.columns.end(), [&](size_t column)
+                               { return column < matrix.dim; });
+        }
+
+        // Transposed copy, columns within every row come out sorted
+        template <typename T>
+        SparseMatrix<T> transposeSparseMatrix(SparseMatrix<T> const &matrix)
+        {
+            SparseMatrix<T> result{};
+            result.dim = matrix.dim;
+            result.rowOffsets.assign(matrix.dim + 1, 0);
+            result.columns.resize(matrix.columns.size());
+            result.values.resize(matrix.values.size());
+
+            for (size_t column : matrix.columns)
+            {
+                result.rowOffsets[column + 1]++;
+            }
+            for (size_t i = 0; i < matrix.dim; i++)
+            {
+                result.rowOffsets[i + 1] += result.rowOffsets[i];
+            }
+
+            std::vector<size_t> next(result.rowOffsets.begin(), result.rowOffsets.end() - 1);
+            for (size_t i = 0; i < matrix.dim; i++)
+            {
+                for (size_t p = matrix.rowOffsets[i]; p < matrix.rowOffsets[i + 1]; p++)
+                {
+                    const size_t position = next[matrix.columns[p]]++;
+                    result.columns[position] = i;
+                    result.values[position] = matrix.values[p];
+                }
+            }
+
+            return result;
+        }
+
+        // Exact symmetry, like isMatrixSymmetric(). Rows are compared in sorted form, so their order does not matter
+        template <typename T>
+        bool isSparseMatrixSymmetric(SparseMatrix<T> const &matrix)
+        {
+            const SparseMatrix<T> transposed = transposeSparseMatrix(matrix);
+            const SparseMatrix<T> sorted = transposeSparseMatrix(transposed);
+            return transposed.columns == sorted.columns && transposed.values == sorted.values;
+        }
+
+        // Reverse Cuthill-McKee ordering of the graph of a symmetric matrix, result[newIndex] == oldIndex.
+        // Every connected component starts from a pseudo-peripheral node (George-Liu), neighbours are visited by degree.
+        inline std::vector<size_t> reverseCuthillMcKee(size_t dim, size_t const *rowOffsets, size_t const *columns)
+        {
+            std::vector<size_t> degree(dim, 0);
+            for (size_t i = 0; i < dim; i++)
+            {
+                for (size_t p = rowOffsets[i]; p < rowOffsets[i + 1]; p++)
+                {
+                    degree[i] += columns[p] != i;
+                }
+            }
+
+            // breadth-first level structure from root, returns its depth and a minimal degree node of the last level
+            std::vector<size_t> levelMark(dim, 0);
+            size_t generation = 0;
+            std::vector<size_t> queue;
+            queue.reserve(dim);
+            auto lastLevel = [&](size_t root, size_t &depth) -> size_t
+            {
+                generation++;
+                queue.assign(1, root);
+                levelMark[root] = generation;
+                size_t levelStart = 0;
+                depth = 0;
+                while (true)
+                {
+                    const size_t levelEnd = queue.size();
+                    for (size_t q = levelStart; q < levelEnd; q++)
+                    {
+                        const size_t node = queue[q];
+                        for (size_t p = rowOffsets[node]; p < rowOffsets[node + 1]; p++)
+                        {
+                            if (levelMark[columns[p]] != generation)
+                            {
+                                levelMark[columns[p]] = generation;
+                                queue.push_back(columns[p]);
+                            }
+                        }
+                    }
+                    if (queue.size() == levelEnd)
+                    {
+                        return *std::min_element(queue.begin() + static_cast<std::ptrdiff_t>(levelStart), queue.end(),
+                                                 [&](size_t a, size_t b)
+                                                 { return degree[a] < degree[b]; });
+                    }
+                    levelStart = levelEnd;
+                    depth++;
+                }
+            };
+
+            // candidates for the roots, by degree
+            std::vector<size_t> byDegree(dim);
+            for (size_t i = 0; i < dim; i++)
+            {
+                byDegree[i] = i;
+            }
+            std::stable_sort(byDegree.begin(), byDegree.end(), [&](size_t a, size_t b)
+                             { return degree[a] < degree[b]; });
+
+            std::vector<bool> visited(dim, false);
+            std::vector<size_t> order;
+            order.reserve(dim);
+            std::vector<size_t> neighbours;
+
+            for (size_t candidate : byDegree)
+            {
+                if (visited[candidate])
+                {
+                    continue;
+                }
+
+                // pseudo-peripheral root: move to the far end of the level structure while it gets deeper
+                size_t root = candidate;
+                size_t depth = 0;
+                size_t far = lastLevel(root, depth);
+                for (size_t attempt = 0; attempt < 8; attempt++)
+                {
+                    size_t farDepth = 0;
+                    const size_t farther = lastLevel(far, farDepth);
+                    if (farDepth <= depth)
+                    {
+                        break;
+                    }
+                    root = far;
+                    depth = farDepth;
+                    far = farther;
+                }
+
+                const size_t componentStart = order.size();
+                order.push_back(root);
+                visited[root] = true;
+                for (size_t q = componentStart; q < order.size(); q++)
+                {
+                    const size_t node = order[q];
+                    neighbours.clear();
+                    for (size_t p = rowOffsets[node]; p < rowOffsets[node + 1]; p++)
+                    {
+                        if (!visited[columns[p]])
+                        {
+                            visited[columns[p]] = true;
+                            neighbours.push_back(columns[p]);
+                        }
+                    }
+                    std::stable_sort(neighbours.begin(), neighbours.end(), [&](size_t a, size_t b)
+                                     { return degree[a] < degree[b]; });
+                    order.insert(order.end(), neighbours.begin(), neighbours.end());
+                }
+            }
+
+            std::reverse(order.begin(), order.end());
+            return order;
+        }
+
+        // Pattern of row k of the factor (columns below k) in topological order, stored in stack[top, dim).
+        // mark[k] must not equal k before the call, lowerRow holds the columns of row k of the matrix.
+        inline size_t sparseEliminationReach(size_t k, size_t const *lowerRowBegin, size_t const *lowerRowEnd,
+                                             size_t const *parent, size_t *mark, size_t *stack, size_t dim)
+        {
+            size_t top = dim;
+            mark[k] = k;
+            for (size_t const *column = lowerRowBegin; column != lowerRowEnd; column++)
+            {
+                size_t node = *column;
+                size_t length = 0;
+                // walk up the elimination tree until an already visited node, k is always reached at the latest
+                for (; mark[node] != k; node = parent[node])
+                {
+                    stack[length++] = node;
+                    mark[node] = k;
+                }
+                while (length > 0)
+                {
+                    stack[--top] = stack[--length];
+                }
+            }
+            return top;
+        }
+
+        // Up-looking sparse Choletsky decomposition of a symmetric matrix given by the lower triangle rows.
+        // The factor is produced in CSR form (rows of L), columns of every row in ascending order.
+        // Returns false if the matrix is not positive-definite.
+        template <typename T>
+        bool trySparseCholetskyDecomposition(size_t dim, std::vector<size_t> const &lowerOffsets, std::vector<size_t> const &lowerColumns,
+                                             std::vector<T> const &lowerValues, std::vector<size_t> &factorOffsets,
+                                             std::vector<size_t> &factorColumns, std::vector<T> &factorValues)
+        {
+            constexpr size_t none = std::numeric_limits<size_t>::max();
+
+            // 1. elimination tree, with path compression through ancestor
+            std::vector<size_t> parent(dim, none);
+            {
+                std::vector<size_t> ancestor(dim, none);
+                for (size_t k = 0; k < dim; k++)
+                {
+                    for (size_t p = lowerOffsets[k]; p < lowerOffsets[k + 1]; p++)
+                    {
+                        for (size_t node = lowerColumns[p]; node != none && node < k;)
+                        {
+                            const size_t next = ancestor[node];
+                            ancestor[node] = k;
+                            if (next == none)
+                            {
+                                parent[node] = k;
+                            }
+                            node = next;
+                        }
+                    }
+                }
+            }
+
+            // 2. symbolic analysis: nonzeros of every column of the factor
+            std::vector<size_t> mark(dim, none);
+            std::vector<size_t> stack(dim);
+            std::vector<size_t> columnOffsets(dim + 1, 0);
+            for (size_t k = 0; k < dim; k++)
+            {
+                const size_t top = sparseEliminationReach(k, lowerColumns.data() + lowerOffsets[k], lowerColumns.data() + lowerOffsets[k + 1],
+                                                          parent.data(), mark.data(), stack.data(), dim);
+                for (size_t q = top; q < dim; q++)
+                {
+                    columnOffsets[stack[q] + 1]++;
+                }
+                columnOffsets[k + 1]++;
+            }
+            for (size_t k = 0; k < dim; k++)
+            {
+                columnOffsets[k + 1] += columnOffsets[k];
+            }
+
+            // 3. numeric factorization, row k of the factor is a sparse triangular solve with the columns found so far.
+            // The factor is built by columns (diagonal first), so the solve can scatter down the columns.
+            const size_t nonZeros = columnOffsets[dim];
+            std::vector<size_t> rows(nonZeros);
+            std::vector<T> values(nonZeros);
+            std::vector<size_t> next(columnOffsets.begin(), columnOffsets.end() - 1);
+            std::vector<T> x(dim, T(0));
+            std::fill(mark.begin(), mark.end(), none);
+
+            for (size_t k = 0; k < dim; k++)
+            {
+                const size_t top = sparseEliminationReach(k, lowerColumns.data() + lowerOffsets[k], lowerColumns.data() + lowerOffsets[k + 1],
+                                                          parent.data(), mark.data(), stack.data(), dim);
+
+                for (size_t p = lowerOffsets[k]; p < lowerOffsets[k + 1]; p++)
+                {
+                    x[lowerColumns[p]] += lowerValues[p];
+                }
+                const T originalDiagonal = x[k];
+                T diagonal = x[k];
+                x[k] = 0;
+
+                for (size_t q = top; q < dim; q++)
+                {
+                    const size_t column = stack[q];
+                    const T value = x[column] / values[columnOffsets[column]];
+                    x[column] = 0;
+                    for (size_t p = columnOffsets[column] + 1; p < next[column]; p++)
+                    {
+                        x[rows[p]] -= values[p] * value;
+                    }
+                    diagonal -= value * value;
+
+                    const size_t position = next[column]++;
+                    rows[position] = k;
+                    values[position] = value;
+                }
+
+                // same relative pivot tolerance as the dense decomposition
+                const T tolerance = std::numeric_limits<T>::epsilon() * static_cast<T>(dim) * originalDiagonal;
+                if (!(diagonal > tolerance) || !std::isfinite(diagonal))
+                {
+                    return false;
+                }
+
+                const size_t position = next[k]++;
+                rows[position] = k;
+                values[position] = std::sqrt(diagonal);
+            }
+
+            // 4. columns -> rows, walking the columns in order keeps every row sorted
+            factorOffsets.assign(dim + 1, 0);
+            for (size_t row : rows)
+            {
+                factorOffsets[row + 1]++;
+            }
+            for (size_t k = 0; k < dim; k++)
+            {
+                factorOffsets[k + 1] += factorOffsets[k];
+            }
+            factorColumns.resize(nonZeros);
+            factorValues.resize(nonZeros);
+            std::copy(factorOffsets.begin(), factorOffsets.end() - 1, next.begin());
+            for (size_t column = 0; column < dim; column++)
+            {
+                for (size_t p = columnOffsets[column]; p < columnOffsets[column + 1]; p++)
+                {
+                    const size_t position = next[rows[p]]++;
+                    factorColumns[position] = column;
+                    factorValues[position] = values[p];
+                }
+            }
+
+            return true;
+        }
+
+        // right-hand sides processed together by the sparse kernels
+        constexpr size_t sparseBatchSize = 16;
+
+        // block = L * block for a lower-triangular CSR factor with sorted rows.
+        // block is component-major: element i of right-hand side b is block[i * stride + b], b < count.
+        // Rows go bottom-up, so the values every row needs are not overwritten yet.
+        template <typename T>
+        void sparseMultiplyInPlace(size_t dim, size_t const *rowOffsets, size_t const *columns, T const *values,
+                                   T *block, size_t stride, size_t count)
+        {
+            T sums[sparseBatchSize];
+            for (size_t i = dim; i-- > 0;)
+            {
+                std::fill(sums, sums + count, T(0));
+                for (size_t p = rowOffsets[i]; p < rowOffsets[i + 1]; p++)
+                {
+                    const T factor = values[p];
+                    T const *source = block + columns[p] * stride;
+                    for (size_t b = 0; b < count; b++)
+                    {
+                        sums[b] += factor * source[b];
+                    }
+                }
+                std::copy(sums, sums + count, block + i * stride);
+            }
+        }
+
+        // Solves L^T * x = block in place for a lower-triangular CSR factor with sorted rows (diagonal last).
+        // Row i of L is column i of L^T: x_i is final once the rows below are done, then it is eliminated upwards.
+        template <typename T>
+        void sparseSolveTransposedInPlace(size_t dim, size_t const *rowOffsets, size_t const *columns, T const *values,
+                                          T *block, size_t stride, size_t count)
+        {
+            for (size_t i = dim; i-- > 0;)
+            {
+                const size_t diagonal = rowOffsets[i + 1] - 1;
+                T *solved = block + i * stride;
+                for (size_t b = 0; b < count; b++)
+                {
+                    solved[b] /= values[diagonal];
+                }
+
+                for (size_t p = rowOffsets[i]; p < diagonal; p++)
+                {
+                    const T factor = values[p];
+                    T *target = block + columns[p] * stride;
+                    for (size_t b = 0; b < count; b++)
+                    {
+                        target[b] -= factor * solved[b];
+                    }
+                }
+            }
+        }
+    } // namespace internal
+
+    namespace internal
+    {
+        // bits of the Sobol points, so at most 2^32 points per sequence
+        constexpr size_t sobolBits = 32;
+
+        // product of polynomials over GF(2) modulo polynomial of the given degree, degree < 32
+        inline std::uint64_t polynomialMultiplyMod(std::uint64_t a, std::uint64_t b, std::uint64_t polynomial, size_t degree)
+        {
+            std::uint64_t result = 0;
+            for (; b != 0; b >>= 1)
+            {
+                if (b & 1)
+                {
+                    result ^= a;
+                }
+                a <<= 1;
+                if ((a >> degree) & 1)
+                {
+                    a ^= polynomial;
+                }
+            }
+            return result;
+        }
+
+        inline std::uint64_t polynomialPowerOfX(std::uint64_t exponent, std::uint64_t polynomial, size_t degree)
+        {
+            std::uint64_t result = 1;
+            std::uint64_t base = degree > 1 ? 2 : 2 ^ polynomial; // x reduced modulo the polynomial
+            for (; exponent != 0; exponent >>= 1)
+            {
+                if (exponent & 1)
+                {
+                    result = polynomialMultiplyMod(result, base, polynomial, degree);
+                }
+                base = polynomialMultiplyMod(base, base, polynomial, degree);
+            }
+            return result;
+        }
+
+        // x has the maximal order 2^degree - 1 modulo a primitive polynomial
+        inline bool isPolynomialPrimitive(std::uint64_t polynomial, size_t degree)
+        {
+            const std::uint64_t order = (std::uint64_t{1} << degree) - 1;
+            if (polynomialPowerOfX(order, polynomial, degree) != 1)
+            {
+                return false;
+            }
+
+            // x^(order / prime) must not be 1 for every prime factor of the order
+            std::uint64_t rest = order;
+            for (std::uint64_t factor = 2; rest > 1; factor++)
+            {
+                if (factor * factor > rest)
+                {
+                    factor = rest; // the remaining prime
+                }
+                if (rest % factor != 0)
+                {
+                    continue;
+                }
+                while (rest % factor == 0)
+                {
+                    rest /= factor;
+                }
+                if (polynomialPowerOfX(order / factor, polynomial, degree) == 1)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Direction numbers of the first dims Sobol dimensions, sobolBits per dimension.
+        // The first dimension is the van der Corput sequence. The others use the primitive polynomials
+        // in order of degree, like the Joe-Kuo tables, with their initial numbers for the first sobolTableDims dimensions.
+        // Past the table the initial numbers are derived from a hash: any odd ones keep the digital net property,
+        // though the two-dimensional projections are not optimized, and the scrambling does the rest.
+        inline std::vector<std::uint32_t> makeSobolDirections(size_t dims)
+        {
+            std::vector<std::uint32_t> directions(dims * sobolBits);
+            for (size_t j = 0; j < sobolBits && dims > 0; j++)
+            {
+                directions[j] = std::uint32_t{1} << (sobolBits - 1 - j);
+            }
+
+            size_t dim = 1;
+            std::uint16_t const *tabulated = sobolInitialNumbers;
+            for (size_t degree = 1; dim < dims && degree < sobolBits; degree++)
+            {
+                for (std::uint64_t middle = 0; middle < (std::uint64_t{1} << (degree - 1)) && dim < dims; middle++)
+                {
+                    const std::uint64_t polynomial = (std::uint64_t{1} << degree) | (middle << 1) | 1;
+                    if (!isPolynomialPrimitive(polynomial, degree))
+                    {
+                        continue;
+                    }
+
+                    std::uint32_t *v = directions.data() + dim * sobolBits;
+                    for (size_t j = 0; j < std::min(degree, sobolBits); j++)
+                    {
+                        // odd and below 2^(j + 1)
+                        const std::uint64_t initial = dim < sobolTableDims
+                                                          ? tabulated[j]
+                                                          : (mixBits(dim * sobolBits + j) & ((std::uint64_t{1} << j) - 1)) * 2 + 1;
+                        v[j] = static_cast<std::uint32_t>(initial << (sobolBits - 1 - j));
+                    }
+                    if (dim < sobolTableDims)
+                    {
+                        tabulated += degree;
+                    }
+                    for (size_t j = degree; j < sobolBits; j++)
+                    {
+                        std::uint32_t value = v[j - degree] ^ (v[j - degree] >> degree);
+                        for (size_t k = 1; k < degree; k++)
+                        {
+                            if ((middle >> (degree - 1 - k)) & 1)
+                            {
+                                value ^= v[j - k];
+                            }
+                        }
+                        v[j] = value;
+                    }
+                    dim++;
+                }
+            }
+
+            return directions;
+        }
+
+        inline std::uint32_t reverseBits(std::uint32_t x)
+        {
+            x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+            x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+            x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+            x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+            return (x >> 16) | (x << 16);
+        }
+
+        // Owen (nested uniform) scrambling by hashing, Burley, "Practical Hash-based Owen Scrambling" (2020).
+        // Every bit is flipped depending on the bits above it only, so the point set keeps its stratification.
+        inline std::uint32_t owenScramble(std::uint32_t x, std::uint32_t seed)
+        {
+            x = reverseBits(x);
+            x += seed;
+            x ^= x * 0x6C50B47Cu;
+            x ^= x * 0xB82F1E52u;
+            x ^= x * 0xC7AFE638u;
+            x ^= x * 0x8D22F6E6u;
+            return reverseBits(x);
+        }
+
+        // Acklam's rational approximation of the inverse normal CDF, refined by inverseNormalCdf()
+        constexpr double inverseNormalLowerBreak = 0.02425;
+        constexpr double inverseNormalCentral[2][6] = {
+            {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00},
+            {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01, 1.0}};
+        constexpr double inverseNormalTail[2][6] = {
+            {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549671010242303e+00, 4.374664141464968e+00, 2.938163982698783e+00},
+            {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00, 1.0, 0.0}};
+
+        // Inverse normal CDF of count uniforms within (0, 1). The central region, almost all values,
+        // is a branch-free loop the compiler can vectorize; the tails are patched afterwards.
+        // std::erfc is used for the refinement, so the last bits may depend on the standard library.
+        MNV_NO_FP_CONTRACT inline void inverseNormalCdf(double const *uniforms, double *out, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const double q = uniforms[i] - 0.5;
+                const double r = q * q;
+                double numerator = inverseNormalCentral[0][0];
+                double denominator = inverseNormalCentral[1][0];
+                for (size_t k = 1; k < 6; k++)
+                {
+                    numerator = numerator * r;
+                    numerator = numerator + inverseNormalCentral[0][k];
+                    denominator = denominator * r;
+                    denominator = denominator + inverseNormalCentral[1][k];
+                }
+                numerator = numerator * q;
+                out[i] = numerator / denominator;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                const double p = uniforms[i];
+                const double lower = std::min(p, 1.0 - p);
+                if (lower >= inverseNormalLowerBreak)
+                {
+                    continue;
+                }
+
+                const double q = std::sqrt(-2 * portableLog(lower));
+                double numerator = inverseNormalTail[0][0];
+                double denominator = inverseNormalTail[1][0];
+                for (size_t k = 1; k < 6; k++)
+                {
+                    numerator = numerator * q;
+                    numerator = numerator + inverseNormalTail[0][k];
+                }
+                for (size_t k = 1; k < 5; k++)
+                {
+                    denominator = denominator * q;
+                    denominator = denominator + inverseNormalTail[1][k];
+                }
+                const double value = numerator / denominator;
+                out[i] = p < 0.5 ? value : -value;
+            }
+
+            // one Halley step with the exact CDF brings every value to double precision.
+            // Done in the lower half, where 1 - p is exact and erfc does not cancel.
+            constexpr double sqrtHalf = 0.70710678118654752440;
+            constexpr double sqrtTwoPi = 2.50662827463100050242;
+            for (size_t i = 0; i < count; i++)
+            {
+                const double p = uniforms[i];
+                const double lower = std::min(p, 1.0 - p);
+                const double x = p < 0.5 ? out[i] : -out[i];
+
+                const double error = 0.5 * std::erfc(-x * sqrtHalf) - lower;
+                const double scaled = error * sqrtTwoPi * portableExp(x * x / 2);
+                const double refined = x - scaled / (1 + x * scaled / 2);
+                out[i] = p < 0.5 ? refined : -refined;
+            }
+        }
+
+        // Sobol point of the given index, coordinates as 32-bit integers. Points are addressed directly through
+        // their Gray code, so any chunk can be started independently, at 32 * dim XORs.
+        inline void sobolPointAt(std::uint32_t const *directions, size_t dim, std::uint64_t index, std::uint32_t *point)
+        {
+            std::fill(point, point + dim, std::uint32_t{0});
+            const std::uint64_t gray = (index ^ (index >> 1)) & 0xFFFFFFFFu;
+            for (size_t j = 0; j < sobolBits; j++)
+            {
+                if ((gray >> j) & 1)
+                {
+                    for (size_t d = 0; d < dim; d++)
+                    {
+                        point[d] ^= directions[d * sobolBits + j];
+                    }
+                }
+            }
+        }
+
+        // Moves point from the given index to the next one. In Gray code order they differ by the direction
+        // of the lowest zero bit of the index, dim XORs.
+        inline void advanceSobolPoint(std::uint32_t const *directions, size_t dim, std::uint64_t index, std::uint32_t *point)
+        {
+            index &= 0xFFFFFFFFu;
+            size_t bit = 0;
+            while ((index >> bit) & 1)
+            {
+                bit++;
+            }
+            bit = std::min(bit, sobolBits - 1);
+            for (size_t d = 0; d < dim; d++)
+            {
+                point[d] ^= directions[d * sobolBits + bit];
+            }
+        }
+
+        // Standard normal vectors of count consecutive points of the scrambled Sobol sequence. point holds the point
+        // of index first and is left at index first + count; uniforms and normals are scratch buffers of dim values.
+        template <typename T>
+        void fillQuasiStandardNormal(std::uint32_t const *directions, std::uint32_t const *scrambles, size_t dim,
+                                     std::uint64_t first, std::uint32_t *point, double *uniforms, double *normals,
+                                     T *out, size_t count)
+        {
+            for (size_t k = 0; k < count; k++)
+            {
+                for (size_t d = 0; d < dim; d++)
+                {
+                    // centre of the 2^-32 cell, never 0 or 1
+                    uniforms[d] = (static_cast<double>(owenScramble(point[d], scrambles[d])) + 0.5) * 0x1p-32;
+                }
+                inverseNormalCdf(uniforms, normals, dim);
+                for (size_t d = 0; d < dim; d++)
+                {
+                    out[k * dim + d] = static_cast<T>(normals[d]);
+                }
+
+                advanceSobolPoint(directions, dim, first + k, point);
+            }
+        }
+    } // namespace internal
+
+    inline Philox4x32::Philox4x32()
+    {
+        seed(default_seed);
+    }
+
+    inline Philox4x32::Philox4x32(std::uint64_t seed, std::uint64_t stream)
+    {
+        this->seed(seed);
+        this->stream(stream);
+    }
+
+    inline void Philox4x32::seed(std::uint64_t seed)
+    {
+        m_key = {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+        stream(0);
+    }
+
+    inline void Philox4x32::stream(std::uint64_t stream)
+    {
+        m_counter = {0, 0, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)};
+        m_position = 4;
+    }
+
+    inline Philox4x32::result_type Philox4x32::operator()()
+    {
+        if (m_position == 4)
+        {
+            generateBlock();
+        }
+
+        return m_block[m_position++];
+    }
+
+    inline void Philox4x32::discard(unsigned long long count)
+    {
+        // remaining words of the current block come first
+        const size_t remaining = 4 - m_position;
+        if (count <= remaining)
+        {
+            m_position += static_cast<size_t>(count);
+            return;
+        }
+        count -= remaining;
+
+        // m_counter already points past the current block, skip whole blocks and land inside the last one
+        const std::uint64_t blocks = (count - 1) / 4;
+        const std::uint64_t blockIndex =
+            ((static_cast<std::uint64_t>(m_counter[1]) << 32) | m_counter[0]) + blocks;
+        m_counter[0] = static_cast<std::uint32_t>(blockIndex);
+        m_counter[1] = static_cast<std::uint32_t>(blockIndex >> 32);
+
+        generateBlock();
+        m_position = static_cast<size_t>((count - 1) % 4) + 1;
+    }
+
+    inline void Philox4x32::generateBlock()
+    {
+        m_block = internal::philox4x32(m_counter, m_key);
+        m_position = 0;
+
+        // 64-bit increment of the block index, the stream words stay untouched
+        if (++m_counter[0] == 0)
+        {
+            ++m_counter[1];
+        }
+    }
+
+    inline bool operator==(Philox4x32 const &lhs, Philox4x32 const &rhs)
+    {
+        return lhs.m_counter == rhs.m_counter && lhs.m_key == rhs.m_key && lhs.m_position == rhs.m_position &&
+               (lhs.m_position == 4 || lhs.m_block == rhs.m_block);
+    }
+
+    inline bool operator!=(Philox4x32 const &lhs, Philox4x32 const &rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    inline std::ostream &operator<<(std::ostream &out, Philox4x32 const &engine)
+    {
+        out << engine.m_key[0] << ' ' << engine.m_key[1];
+        for (std::uint32_t word : engine.m_counter)
+        {
+            out << ' ' << word;
+        }
+        for (std::uint32_t word : engine.m_block)
+        {
+            out << ' ' << word;
+        }
+        return out << ' ' << engine.m_position;
+    }
+
+    inline std::istream &operator>>(std::istream &in, Philox4x32 &engine)
+    {
+        Philox4x32 state{};
+        in >> state.m_key[0] >> state.m_key[1];
+        for (std::uint32_t &word : state.m_counter)
+        {
+            in >> word;
+        }
+        for (std::uint32_t &word : state.m_block)
+        {
+            in >> word;
+        }
+        in >> state.m_position;
+
+        if (in && state.m_position <= 4)
+        {
+            engine = state;
+        }
+        else
+        {
+            in.setstate(std::ios::failbit);
+        }
+        return in;
+    }
+
+    inline std::variant<SnapshotFile, MNVGeneratorBuildError> SnapshotFile::open(std::string const &path)
+    {
+        SnapshotFile file{};
+
+#ifdef MNV_SNAPSHOT_MMAP
+        const int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+        {
+            return internal::snapshotIsNotValid();
+        }
+
+        struct stat status{};
+        if (::fstat(descriptor, &status) != 0 || status.st_size <= 0)
+        {
+            ::close(descriptor);
+            return internal::snapshotIsNotValid();
+        }
+
+        const size_t size = static_cast<size_t>(status.st_size);
+        void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        ::close(descriptor);
+        if (mapping == MAP_FAILED)
+        {
+            return internal::snapshotIsNotValid();
+        }
+
+        file.m_data = mapping;
+        file.m_size = size;
+        file.m_mapped = true;
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+        {
+            return internal::snapshotIsNotValid();
+        }
+
+        const std::streamoff size = in.tellg();
+        if (size <= 0)
+        {
+            return internal::snapshotIsNotValid();
+        }
+
+        void *buffer = ::operator new(static_cast<size_t>(size), std::align_val_t{internal::cacheLineSize});
+        file.m_data = buffer;
+        file.m_size = static_cast<size_t>(size);
+
+        in.seekg(0);
+        if (!in.read(static_cast<char *>(buffer), static_cast<std::streamsize>(size)))
+        {
+            return internal::snapshotIsNotValid();
+        }
+#endif
+
+        return file;
+    }
+
+    inline void const *SnapshotFile::data() const
+    {
+        return m_data;
+    }
+
+    inline size_t SnapshotFile::size() const
+    {
+        return m_size;
+    }
+
+    inline SnapshotFile::SnapshotFile(SnapshotFile &&other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)), m_mapped(other.m_mapped)
+    {
+    }
+
+    inline SnapshotFile &SnapshotFile::operator=(SnapshotFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            this->~SnapshotFile();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_mapped = other.m_mapped;
+        }
+        return *this;
+    }
+
+    inline SnapshotFile::~SnapshotFile()
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+
+#ifdef MNV_SNAPSHOT_MMAP
+        if (m_mapped)
+        {
+            ::munmap(const_cast<void *>(m_data), m_size);
+            return;
+        }
+#endif
+        ::operator delete(const_cast<void *>(m_data), std::align_val_t{internal::cacheLineSize});
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> MNVGenerator<T, Dim, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::nextValues(T *out, size_t count)
+    {
+        internal::generateValues(m_generator, m_decomposedCovariance.data(), m_mean.data(), Dim, out, count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::nextAntitheticValues(T *out, size_t count)
+    {
+        internal::generateAntitheticValues(m_generator, m_decomposedCovariance.data(), m_mean.data(), Dim, out, count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::nextAntitheticValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextAntitheticValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::optional<MNVGeneratorBuildError> MNVGenerator<T, Dim, Engine>::nextMomentMatchedValues(T *out, size_t count)
+    {
+        if (!internal::generateMomentMatchedValues(m_generator, m_decomposedCovariance.data(), m_mean.data(), Dim, out, count))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The batch covariance matrix is not positive-definite, a moment-matched batch needs more values than dimensions\n")};
+        }
+        return std::nullopt;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::optional<MNVGeneratorBuildError> MNVGenerator<T, Dim, Engine>::nextMomentMatchedValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        return nextMomentMatchedValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::generateParallel(T *out, size_t count, size_t threads)
+    {
+        const std::uint64_t firstSubstream = m_nextSubstream;
+        m_nextSubstream += (count + internal::parallelChunkSize - 1) / internal::parallelChunkSize;
+
+        internal::generateValuesParallel<T, Engine>(m_seed, firstSubstream, m_decomposedCovariance.data(), m_mean.data(), Dim,
+                                                    out, count, threads);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::generateParallel(valueVector<T, Dim> *out, size_t count, size_t threads)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        generateParallel(out->data(), count, threads);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MNVGenerator<T, Dim, Engine>::build(
+        MatrixSq<T, Dim> const &covariance,
+        valueVector<T, Dim> const &mean,
+        size_t seed,
+        size_t threads)
+    {
+        // 1. Check for symmetric matrix
+
+        if (!internal::isMatrixSymmetric(covariance))
+        {
+            // error: ABSOLUTELY wrong matrix
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        // 2. Check for positive-definite matrix, the factor is kept for the generator
+        // heap-allocated, so large Dim does not exhaust the stack
+
+        auto decomposed = std::make_unique<MatrixLowerTriangular<T, Dim>>();
+        if (!internal::tryCholetskyDecomposition(covariance, *decomposed, threads))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        return MNVGenerator<T, Dim, Engine>(*decomposed, mean, seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MNVGenerator<T, Dim, Engine>::build(
+        std::vector<valueVector<T, Dim>> const &statisticVectors,
+        size_t seed)
+    {
+        return build(calculateCovarianceMatrix(statisticVectors),
+                     calculateMeanVector(statisticVectors),
+                     seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MNVGenerator<T, Dim, Engine>::build(
+        CovarianceAccumulator<T, Dim> const &statistics,
+        size_t seed)
+    {
+        return build(statistics.covariance(), statistics.mean(), seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MNVGenerator<T, Dim, Engine>::build(
+        CovarianceFactor<T, Dim> const &factor,
+        valueVector<T, Dim> const &mean,
+        size_t seed)
+    {
+        // everything was checked when the factor was made, possibly at compile time
+
+        if (factor.valid)
+        {
+            return MNVGenerator<T, Dim, Engine>(factor.lower, mean, seed);
+        }
+
+        if (factor.error == MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric)
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        return MNVGeneratorBuildError{
+            MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+            ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::seed(size_t seed)
+    {
+        m_seed = seed;
+        m_nextSubstream = 0;
+        m_generator.seed(seed);
+        return;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    Engine &MNVGenerator<T, Dim, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::update(valueVector<T, Dim> const &v)
+    {
+        internal::choletskyRankOneUpdate(m_decomposedCovariance.data(), Dim, v.data(), false);
+        m_logDeterminant = internal::choletskyLogDeterminant(m_decomposedCovariance.data(), Dim);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::optional<MNVGeneratorBuildError> MNVGenerator<T, Dim, Engine>::downdate(valueVector<T, Dim> const &v)
+    {
+        if (!internal::choletskyRankOneUpdate(m_decomposedCovariance.data(), Dim, v.data(), true))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The downdated covariance matrix would not be positive-definite, the generator was left unchanged\n")};
+        }
+        m_logDeterminant = internal::choletskyLogDeterminant(m_decomposedCovariance.data(), Dim);
+        return std::nullopt;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::optional<MNVGeneratorBuildError> MNVGenerator<T, Dim, Engine>::observe(valueVector<T, Dim> const &value, T decay)
+    {
+        if (!(decay > 0) || !(decay <= 1))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DecayIsOutOfRange,
+                ERRMSG("The decay must be within (0, 1]\n")};
+        }
+
+        internal::choletskyExponentialUpdate(m_decomposedCovariance.data(), m_mean.data(), Dim, value.data(), decay);
+        m_logDeterminant = internal::choletskyLogDeterminant(m_decomposedCovariance.data(), Dim);
+        return std::nullopt;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    T MNVGenerator<T, Dim, Engine>::logPdf(valueVector<T, Dim> const &x) const
+    {
+        valueVector<T, Dim> solved;
+        T result = internal::squaredMahalanobisDistance(m_decomposedCovariance.data(), m_mean.data(), Dim, x.data(), solved.data());
+        internal::logPdfFromSquaredDistances(m_logDeterminant, Dim, &result, 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::logPdf(T const *points, size_t count, T *out) const
+    {
+        internal::squaredMahalanobisDistances(m_decomposedCovariance.data(), m_mean.data(), Dim, points, count, out);
+        internal::logPdfFromSquaredDistances(m_logDeterminant, Dim, out, count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    T MNVGenerator<T, Dim, Engine>::mahalanobis(valueVector<T, Dim> const &x) const
+    {
+        valueVector<T, Dim> solved;
+        T result = internal::squaredMahalanobisDistance(m_decomposedCovariance.data(), m_mean.data(), Dim, x.data(), solved.data());
+        internal::mahalanobisFromSquaredDistances(&result, 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::mahalanobis(T const *points, size_t count, T *out) const
+    {
+        internal::squaredMahalanobisDistances(m_decomposedCovariance.data(), m_mean.data(), Dim, points, count, out);
+        internal::mahalanobisFromSquaredDistances(out, count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVGenerator<T, Dim, Engine>::save(std::ostream &out) const
+    {
+        internal::writeSnapshot(out, m_decomposedCovariance.data(), m_mean.data(), Dim, m_seed, m_nextSubstream, m_generator);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MNVGenerator<T, Dim, Engine>::load(void const *data, size_t size)
+    {
+        internal::SnapshotHeader header{};
+        if (!internal::readSnapshotHeader<T>(data, size, header))
+        {
+            return internal::snapshotIsNotValid();
+        }
+        if (header.dim != Dim)
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                ERRMSG("The snapshot was saved by a generator of another dimension\n")};
+        }
+
+        unsigned char const *storage = static_cast<unsigned char const *>(data) + sizeof(internal::SnapshotHeader);
+        auto decomposed = std::make_unique<MatrixLowerTriangular<T, Dim>>();
+        valueVector<T, Dim> mean{};
+        std::memcpy(decomposed->data(), storage, decomposed->size() * sizeof(T));
+        std::memcpy(mean.data(), storage + internal::alignedSize<T>(decomposed->size()) * sizeof(T), Dim * sizeof(T));
+
+        MNVGenerator<T, Dim, Engine> generator(*decomposed, mean, 1);
+        if (!internal::readSnapshotEngine(data, header, internal::snapshotStorageSize<T>(Dim) * sizeof(T), generator.m_generator))
+        {
+            return internal::snapshotIsNotValid();
+        }
+        generator.m_seed = static_cast<size_t>(header.seed);
+        generator.m_nextSubstream = header.nextSubstream;
+        return generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MNVGenerator<T, Dim, Engine>::load(std::istream &in)
+    {
+        std::ostringstream buffer{};
+        buffer << in.rdbuf();
+        const std::string bytes = buffer.str();
+        return load(bytes.data(), bytes.size());
+    }
+
+    // private constructor is used to force MNVGenerator::build()
+    template <typename T, size_t Dim, typename Engine>
+    MNVGenerator<T, Dim, Engine>::MNVGenerator(MatrixLowerTriangular<T, Dim> const &decomposedCovariance, valueVector<T, Dim> const &mean, size_t seed)
+        : m_decomposedCovariance(decomposedCovariance), m_mean(mean),
+          m_logDeterminant(internal::choletskyLogDeterminant(decomposedCovariance.data(), Dim))
+    {
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, typename Engine>
+    std::vector<T> DynamicMNVGenerator<T, Engine>::nextValue()
+    {
+        std::vector<T> result(m_dim);
+        nextValue(result.data());
+        return result;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::nextValue(T *out)
+    {
+        nextValues(out, 1);
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::nextValues(T *out, size_t count)
+    {
+        internal::generateValues(m_generator, decomposedCovariance(), mean(), m_dim, out, count);
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::nextAntitheticValues(T *out, size_t count)
+    {
+        internal::generateAntitheticValues(m_generator, decomposedCovariance(), mean(), m_dim, out, count);
+    }
+
+    template <typename T, typename Engine>
+    std::optional<MNVGeneratorBuildError> DynamicMNVGenerator<T, Engine>::nextMomentMatchedValues(T *out, size_t count)
+    {
+        if (!internal::generateMomentMatchedValues(m_generator, decomposedCovariance(), mean(), m_dim, out, count))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The batch covariance matrix is not positive-definite, a moment-matched batch needs more values than dimensions\n")};
+        }
+        return std::nullopt;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::generateParallel(T *out, size_t count, size_t threads)
+    {
+        const std::uint64_t firstSubstream = m_nextSubstream;
+        m_nextSubstream += (count + internal::parallelChunkSize - 1) / internal::parallelChunkSize;
+
+        internal::generateValuesParallel<T, Engine>(m_seed, firstSubstream, decomposedCovariance(), mean(), m_dim,
+                                                    out, count, threads);
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::seed(size_t seed)
+    {
+        m_seed = seed;
+        m_nextSubstream = 0;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, typename Engine>
+    Engine &DynamicMNVGenerator<T, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::update(T const *v)
+    {
+        makeStorageOwned();
+        internal::choletskyRankOneUpdate(m_storage.get(), m_dim, v, false);
+        m_logDeterminant = internal::choletskyLogDeterminant(m_storage.get(), m_dim);
+    }
+
+    template <typename T, typename Engine>
+    std::optional<MNVGeneratorBuildError> DynamicMNVGenerator<T, Engine>::downdate(T const *v)
+    {
+        makeStorageOwned();
+        if (!internal::choletskyRankOneUpdate(m_storage.get(), m_dim, v, true))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The downdated covariance matrix would not be positive-definite, the generator was left unchanged\n")};
+        }
+        m_logDeterminant = internal::choletskyLogDeterminant(m_storage.get(), m_dim);
+        return std::nullopt;
+    }
+
+    template <typename T, typename Engine>
+    std::optional<MNVGeneratorBuildError> DynamicMNVGenerator<T, Engine>::observe(T const *value, T decay)
+    {
+        if (!(decay > 0) || !(decay <= 1))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DecayIsOutOfRange,
+                ERRMSG("The decay must be within (0, 1]\n")};
+        }
+
+        makeStorageOwned();
+        internal::choletskyExponentialUpdate(m_storage.get(), m_storage.get() + internal::alignedSize<T>(internal::packedRowOffset(m_dim)), m_dim, value, decay);
+        m_logDeterminant = internal::choletskyLogDeterminant(m_storage.get(), m_dim);
+        return std::nullopt;
+    }
+
+    template <typename T, typename Engine>
+    T DynamicMNVGenerator<T, Engine>::logPdf(T const *x) const
+    {
+        // small dimensions are solved on the stack, without an allocation
+        constexpr size_t stackDim = 64;
+        T stackSolved[stackDim];
+        std::vector<T> heapSolved(m_dim > stackDim ? m_dim : 0);
+        T result = internal::squaredMahalanobisDistance(decomposedCovariance(), mean(), m_dim, x,
+                                                        m_dim > stackDim ? heapSolved.data() : stackSolved);
+        internal::logPdfFromSquaredDistances(m_logDeterminant, m_dim, &result, 1);
+        return result;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::logPdf(T const *points, size_t count, T *out) const
+    {
+        internal::squaredMahalanobisDistances(decomposedCovariance(), mean(), m_dim, points, count, out);
+        internal::logPdfFromSquaredDistances(m_logDeterminant, m_dim, out, count);
+    }
+
+    template <typename T, typename Engine>
+    T DynamicMNVGenerator<T, Engine>::mahalanobis(T const *x) const
+    {
+        // small dimensions are solved on the stack, without an allocation
+        constexpr size_t stackDim = 64;
+        T stackSolved[stackDim];
+        std::vector<T> heapSolved(m_dim > stackDim ? m_dim : 0);
+        T result = internal::squaredMahalanobisDistance(decomposedCovariance(), mean(), m_dim, x,
+                                                        m_dim > stackDim ? heapSolved.data() : stackSolved);
+        internal::mahalanobisFromSquaredDistances(&result, 1);
+        return result;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::mahalanobis(T const *points, size_t count, T *out) const
+    {
+        internal::squaredMahalanobisDistances(decomposedCovariance(), mean(), m_dim, points, count, out);
+        internal::mahalanobisFromSquaredDistances(out, count);
+    }
+
+    template <typename T, typename Engine>
+    size_t DynamicMNVGenerator<T, Engine>::dimension() const
+    {
+        return m_dim;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::save(std::ostream &out) const
+    {
+        internal::writeSnapshot(out, decomposedCovariance(), mean(), m_dim, m_seed, m_nextSubstream, m_generator);
+    }
+
+    template <typename T, typename Engine>
+    std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    DynamicMNVGenerator<T, Engine>::load(void const *data, size_t size)
+    {
+        internal::SnapshotHeader header{};
+        if (!internal::readSnapshotHeader<T>(data, size, header))
+        {
+            return internal::snapshotIsNotValid();
+        }
+
+        const size_t dim = static_cast<size_t>(header.dim);
+        const size_t storageSize = internal::alignedSize<T>(internal::packedRowOffset(dim)) + dim;
+        auto storage = internal::makeAlignedBuffer<T>(storageSize);
+        std::memcpy(storage.get(), static_cast<unsigned char const *>(data) + sizeof(internal::SnapshotHeader), storageSize * sizeof(T));
+
+        DynamicMNVGenerator<T, Engine> generator(std::move(storage), dim, 1);
+        if (!internal::readSnapshotEngine(data, header, internal::snapshotStorageSize<T>(dim) * sizeof(T), generator.m_generator))
+        {
+            return internal::snapshotIsNotValid();
+        }
+        generator.m_seed = static_cast<size_t>(header.seed);
+        generator.m_nextSubstream = header.nextSubstream;
+        return generator;
+    }
+
+    template <typename T, typename Engine>
+    std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    DynamicMNVGenerator<T, Engine>::load(std::istream &in)
+    {
+        std::ostringstream buffer{};
+        buffer << in.rdbuf();
+        const std::string bytes = buffer.str();
+        return load(bytes.data(), bytes.size());
+    }
+
+    template <typename T, typename Engine>
+    std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    DynamicMNVGenerator<T, Engine>::load(std::shared_ptr<SnapshotFile const> file)
+    {
+        internal::SnapshotHeader header{};
+        if (!file || !internal::readSnapshotHeader<T>(file->data(), file->size(), header))
+        {
+            return internal::snapshotIsNotValid();
+        }
+
+        const size_t dim = static_cast<size_t>(header.dim);
+        DynamicMNVGenerator<T, Engine> generator(nullptr, dim, 1);
+        if (!internal::readSnapshotEngine(file->data(), header, internal::snapshotStorageSize<T>(dim) * sizeof(T), generator.m_generator))
+        {
+            return internal::snapshotIsNotValid();
+        }
+        generator.m_seed = static_cast<size_t>(header.seed);
+        generator.m_nextSubstream = header.nextSubstream;
+
+        // the mapping is cache-aligned, and so is the storage right after the 64-byte header
+        generator.m_mappedStorage = reinterpret_cast<T const *>(static_cast<unsigned char const *>(file->data()) + sizeof(internal::SnapshotHeader));
+        generator.m_snapshot = std::move(file);
+        generator.m_logDeterminant = internal::choletskyLogDeterminant(generator.decomposedCovariance(), dim);
+        return generator;
+    }
+
+    template <typename T, typename Engine>
+    void DynamicMNVGenerator<T, Engine>::makeStorageOwned()
+    {
+        if (m_mappedStorage == nullptr)
+        {
+            return;
+        }
+
+        const size_t storageSize = internal::alignedSize<T>(internal::packedRowOffset(m_dim)) + m_dim;
+        auto storage = internal::makeAlignedBuffer<T>(storageSize);
+        std::copy(m_mappedStorage, m_mappedStorage + storageSize, storage.get());
+
+        m_storage = std::move(storage);
+        m_mappedStorage = nullptr;
+        m_snapshot.reset();
+    }
+
+    template <typename T, typename Engine>
+    std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    DynamicMNVGenerator<T, Engine>::build(
+        T const *covariance,
+        T const *mean,
+        size_t dim,
+        size_t seed,
+        size_t threads)
+    {
+        // 1. Check for symmetric matrix
+
+        if (!internal::isMatrixSymmetric(covariance, dim))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        // 2. Check for positive-definite matrix, the factor is computed in place in the generator's storage
+
+        const size_t factorSize = internal::alignedSize<T>(internal::packedRowOffset(dim));
+        auto storage = internal::makeAlignedBuffer<T>(factorSize + dim);
+        if (!internal::tryCholetskyDecomposition(covariance, dim, storage.get(), threads))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        std::copy(mean, mean + dim, storage.get() + factorSize);
+
+        return DynamicMNVGenerator<T, Engine>(std::move(storage), dim, seed);
+    }
+
+    template <typename T, typename Engine>
+    std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    DynamicMNVGenerator<T, Engine>::build(
+        std::vector<T> const &covariance,
+        std::vector<T> const &mean,
+        size_t seed,
+        size_t threads)
+    {
+        if (covariance.size() != mean.size() * mean.size())
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                ERRMSG("The covariance matrix provided must have exactly mean.size() * mean.size() elements.\n")};
+        }
+
+        return build(covariance.data(), mean.data(), mean.size(), seed, threads);
+    }
+
+    // private constructor is used to force DynamicMNVGenerator::build()
+    template <typename T, typename Engine>
+    DynamicMNVGenerator<T, Engine>::DynamicMNVGenerator(std::unique_ptr<T[], internal::AlignedDeleter<T>> storage, size_t dim, size_t seed)
+        : m_storage(std::move(storage)), m_dim(dim)
+    {
+        if (m_storage)
+        {
+            m_logDeterminant = internal::choletskyLogDeterminant(m_storage.get(), dim);
+        }
+
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, typename Engine>
+    T const *DynamicMNVGenerator<T, Engine>::decomposedCovariance() const
+    {
+        return m_mappedStorage != nullptr ? m_mappedStorage : m_storage.get();
+    }
+
+    template <typename T, typename Engine>
+    T const *DynamicMNVGenerator<T, Engine>::mean() const
+    {
+        return decomposedCovariance() + internal::alignedSize<T>(internal::packedRowOffset(m_dim));
+    }
+
+    template <typename T, size_t Dim>
+    template <typename Engine>
+    MNVSampler<T, Dim, Engine> MNVDistribution<T, Dim>::sampler(size_t seed) const
+    {
+        return MNVSampler<T, Dim, Engine>(*this, seed);
+    }
+
+    template <typename T, size_t Dim>
+    T const *MNVDistribution<T, Dim>::decomposedCovariance() const
+    {
+        return m_storage.get();
+    }
+
+    template <typename T, size_t Dim>
+    T const *MNVDistribution<T, Dim>::mean() const
+    {
+        return m_storage.get() + internal::alignedSize<T>(internal::packedRowOffset(Dim));
+    }
+
+    template <typename T, size_t Dim>
+    T MNVDistribution<T, Dim>::logPdf(valueVector<T, Dim> const &x) const
+    {
+        valueVector<T, Dim> solved;
+        T result = internal::squaredMahalanobisDistance(decomposedCovariance(), mean(), Dim, x.data(), solved.data());
+        internal::logPdfFromSquaredDistances(m_logDeterminant, Dim, &result, 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    void MNVDistribution<T, Dim>::logPdf(T const *points, size_t count, T *out) const
+    {
+        internal::squaredMahalanobisDistances(decomposedCovariance(), mean(), Dim, points, count, out);
+        internal::logPdfFromSquaredDistances(m_logDeterminant, Dim, out, count);
+    }
+
+    template <typename T, size_t Dim>
+    T MNVDistribution<T, Dim>::mahalanobis(valueVector<T, Dim> const &x) const
+    {
+        valueVector<T, Dim> solved;
+        T result = internal::squaredMahalanobisDistance(decomposedCovariance(), mean(), Dim, x.data(), solved.data());
+        internal::mahalanobisFromSquaredDistances(&result, 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    void MNVDistribution<T, Dim>::mahalanobis(T const *points, size_t count, T *out) const
+    {
+        internal::squaredMahalanobisDistances(decomposedCovariance(), mean(), Dim, points, count, out);
+        internal::mahalanobisFromSquaredDistances(out, count);
+    }
+
+    template <typename T, size_t Dim>
+    std::variant<MNVDistribution<T, Dim>, MNVGeneratorBuildError>
+    MNVDistribution<T, Dim>::build(
+        MatrixSq<T, Dim> const &covariance,
+        valueVector<T, Dim> const &mean,
+        size_t threads)
+    {
+        // 1. Check for symmetric matrix
+
+        if (!internal::isMatrixSymmetric(covariance))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        // 2. Check for positive-definite matrix, the factor is computed in place in the shared storage
+
+        const size_t factorSize = internal::alignedSize<T>(internal::packedRowOffset(Dim));
+        auto storage = internal::makeAlignedBuffer<T>(factorSize + Dim);
+        if (!internal::tryCholetskyDecomposition(covariance[0].data(), Dim, storage.get(), threads))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        std::copy(mean.begin(), mean.end(), storage.get() + factorSize);
+
+        return MNVDistribution<T, Dim>(std::shared_ptr<T const>(storage.release(), internal::AlignedDeleter<T>{}));
+    }
+
+    template <typename T, size_t Dim>
+    std::variant<MNVDistribution<T, Dim>, MNVGeneratorBuildError>
+    MNVDistribution<T, Dim>::build(
+        CovarianceFactor<T, Dim> const &factor,
+        valueVector<T, Dim> const &mean)
+    {
+        if (!factor.valid)
+        {
+            return MNVGeneratorBuildError{
+                factor.error,
+                ERRMSG("The covariance matrix the factor was made from is not symmetric or not positive-definite\n")};
+        }
+
+        const size_t factorSize = internal::alignedSize<T>(internal::packedRowOffset(Dim));
+        auto storage = internal::makeAlignedBuffer<T>(factorSize + Dim);
+        std::copy(factor.lower.begin(), factor.lower.end(), storage.get());
+        std::copy(mean.begin(), mean.end(), storage.get() + factorSize);
+
+        return MNVDistribution<T, Dim>(std::shared_ptr<T const>(storage.release(), internal::AlignedDeleter<T>{}));
+    }
+
+    // private constructor is used to force MNVDistribution::build()
+    template <typename T, size_t Dim>
+    MNVDistribution<T, Dim>::MNVDistribution(std::shared_ptr<T const> storage)
+        : m_storage(std::move(storage)), m_logDeterminant(internal::choletskyLogDeterminant(m_storage.get(), Dim))
+    {
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> MNVSampler<T, Dim, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVSampler<T, Dim, Engine>::nextValues(T *out, size_t count)
+    {
+        internal::generateValues(m_generator, m_distribution.decomposedCovariance(), m_distribution.mean(), Dim, out, count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVSampler<T, Dim, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVSampler<T, Dim, Engine>::generateParallel(T *out, size_t count, size_t threads)
+    {
+        const std::uint64_t firstSubstream = m_nextSubstream;
+        m_nextSubstream += (count + internal::parallelChunkSize - 1) / internal::parallelChunkSize;
+
+        internal::generateValuesParallel<T, Engine>(m_seed, firstSubstream, m_distribution.decomposedCovariance(), m_distribution.mean(), Dim,
+                                                    out, count, threads);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MNVSampler<T, Dim, Engine>::seed(size_t seed)
+    {
+        m_seed = seed;
+        m_nextSubstream = 0;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    Engine &MNVSampler<T, Dim, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    MNVDistribution<T, Dim> const &MNVSampler<T, Dim, Engine>::distribution() const
+    {
+        return m_distribution;
+    }
+
+    // private constructor is used to force MNVDistribution::sampler()
+    template <typename T, size_t Dim, typename Engine>
+    MNVSampler<T, Dim, Engine>::MNVSampler(MNVDistribution<T, Dim> distribution, size_t seed)
+        : m_distribution(std::move(distribution))
+    {
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void ConditionalMNVGenerator<T, Dim, Engine>::condition(T const *observedValues)
+    {
+        for (size_t k = 0; k < m_observed.size(); k++)
+        {
+            m_deviation[k] = observedValues[k] - m_mean[m_observed[k]];
+            m_template[m_observed[k]] = observedValues[k];
+        }
+        updateConditionalMean();
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void ConditionalMNVGenerator<T, Dim, Engine>::condition(valueVector<T, Dim> const &point)
+    {
+        for (size_t k = 0; k < m_observed.size(); k++)
+        {
+            const size_t component = m_observed[k];
+            m_deviation[k] = point[component] - m_mean[component];
+            m_template[component] = point[component];
+        }
+        updateConditionalMean();
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void ConditionalMNVGenerator<T, Dim, Engine>::updateConditionalMean()
+    {
+        const size_t observed = m_observed.size();
+        for (size_t j = 0; j < m_free.size(); j++)
+        {
+            T const *row = m_regression.data() + j * observed;
+            T acc{};
+            for (size_t k = 0; k < observed; k++)
+            {
+                acc += row[k] * m_deviation[k];
+            }
+            m_conditionalMean[j] = m_mean[m_free[j]] + acc;
+        }
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> ConditionalMNVGenerator<T, Dim, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void ConditionalMNVGenerator<T, Dim, Engine>::nextValues(T *out, size_t count)
+    {
+        const size_t freeCount = m_free.size();
+        m_buffer.resize(count * freeCount);
+        internal::generateValues(m_generator, m_schurFactor.data(), m_conditionalMean.data(), freeCount, m_buffer.data(), count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            T *value = out + i * Dim;
+            T const *drawn = m_buffer.data() + i * freeCount;
+            std::copy(m_template.begin(), m_template.end(), value);
+            for (size_t j = 0; j < freeCount; j++)
+            {
+                value[m_free[j]] = drawn[j];
+            }
+        }
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void ConditionalMNVGenerator<T, Dim, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> ConditionalMNVGenerator<T, Dim, Engine>::conditionalMean() const
+    {
+        valueVector<T, Dim> result = m_template;
+        for (size_t j = 0; j < m_free.size(); j++)
+        {
+            result[m_free[j]] = m_conditionalMean[j];
+        }
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::vector<size_t> const &ConditionalMNVGenerator<T, Dim, Engine>::observedIndices() const
+    {
+        return m_observed;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::vector<size_t> const &ConditionalMNVGenerator<T, Dim, Engine>::freeIndices() const
+    {
+        return m_free;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void ConditionalMNVGenerator<T, Dim, Engine>::seed(size_t seed)
+    {
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    Engine &ConditionalMNVGenerator<T, Dim, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<ConditionalMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    ConditionalMNVGenerator<T, Dim, Engine>::build(
+        MatrixSq<T, Dim> const &covariance,
+        valueVector<T, Dim> const &mean,
+        std::vector<size_t> observedIndices,
+        size_t seed)
+    {
+        // 1. Check the partition
+
+        std::vector<bool> isObserved(Dim);
+        for (size_t index : observedIndices)
+        {
+            if (index >= Dim || isObserved[index])
+            {
+                return MNVGeneratorBuildError{
+                    MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                    ERRMSG("The observed indices must be distinct and less than the dimension\n")};
+            }
+            isObserved[index] = true;
+        }
+        if (observedIndices.size() == Dim)
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                ERRMSG("At least one component must be left free\n")};
+        }
+
+        // 2. Check for symmetric matrix
+
+        if (!internal::isMatrixSymmetric(covariance))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        ConditionalMNVGenerator<T, Dim, Engine> generator{};
+        generator.m_observed = std::move(observedIndices);
+        for (size_t i = 0; i < Dim; i++)
+        {
+            if (!isObserved[i])
+            {
+                generator.m_free.push_back(i);
+            }
+        }
+        std::vector<size_t> const &observedComponents = generator.m_observed;
+        std::vector<size_t> const &freeComponents = generator.m_free;
+        const size_t observed = observedComponents.size();
+
+        // 3. Choletsky factor L11 of the observed block. If it fails, or the Schur complement factorization below does,
+        // the whole matrix is not positive-definite.
+
+        std::vector<T> observedFactor(internal::packedRowOffset(observed));
+        for (size_t i = 0; i < observed; i++)
+        {
+            for (size_t j = 0; j <= i; j++)
+            {
+                observedFactor[internal::packedRowOffset(i) + j] = covariance[observedComponents[i]][observedComponents[j]];
+            }
+        }
+        bool positiveDefinite = internal::tryCholetskyDecompositionInPlace(observedFactor.data(), observed);
+
+        // 4. W = L11^-1 * covariance12, column by column. Schur complement = covariance22 - W^T * W, A = (L11^-T * W)^T
+
+        std::vector<T> whitened(freeComponents.size() * observed);
+        generator.m_regression.resize(freeComponents.size() * observed);
+        for (size_t j = 0; positiveDefinite && j < freeComponents.size(); j++)
+        {
+            T *w = whitened.data() + j * observed;
+            for (size_t k = 0; k < observed; k++)
+            {
+                w[k] = covariance[observedComponents[k]][freeComponents[j]];
+            }
+            internal::choletskySolveInPlace(observedFactor.data(), observed, w);
+
+            T *a = generator.m_regression.data() + j * observed;
+            std::copy(w, w + observed, a);
+            internal::choletskySolveTransposedInPlace(observedFactor.data(), observed, a);
+        }
+
+        generator.m_schurFactor.resize(internal::packedRowOffset(freeComponents.size()));
+        for (size_t i = 0; positiveDefinite && i < freeComponents.size(); i++)
+        {
+            for (size_t j = 0; j <= i; j++)
+            {
+                T const *wi = whitened.data() + i * observed;
+                T const *wj = whitened.data() + j * observed;
+                T acc = covariance[freeComponents[i]][freeComponents[j]];
+                for (size_t k = 0; k < observed; k++)
+                {
+                    acc -= wi[k] * wj[k];
+                }
+                generator.m_schurFactor[internal::packedRowOffset(i) + j] = acc;
+            }
+        }
+        positiveDefinite = positiveDefinite && internal::tryCholetskyDecompositionInPlace(generator.m_schurFactor.data(), freeComponents.size());
+
+        if (!positiveDefinite)
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        // 5. conditioned on the means until condition() is called
+
+        generator.m_mean = mean;
+        generator.m_template = mean;
+        generator.m_deviation.resize(observed);
+        generator.m_conditionalMean.resize(freeComponents.size());
+        for (size_t j = 0; j < freeComponents.size(); j++)
+        {
+            generator.m_conditionalMean[j] = mean[freeComponents[j]];
+        }
+
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        generator.m_generator.seed(seed);
+
+        return generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> TruncatedMNVGenerator<T, Dim, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void TruncatedMNVGenerator<T, Dim, Engine>::nextValues(T *out, size_t count)
+    {
+        T const *lower = m_decomposedCovariance.data();
+        for (size_t k = 0; k < count; k++)
+        {
+            for (size_t sweep = 0; sweep < m_sweepsPerValue; sweep++)
+            {
+                internal::truncatedGibbsSweep(m_generator, lower, m_mean.data(), m_lowerBounds.data(), m_upperBounds.data(),
+                                              Dim, m_whitened.data(), m_shifted.data());
+            }
+
+            // L * z afresh, so the updates of the sweeps do not accumulate rounding; clamped for the last ulp
+            T *value = out + k * Dim;
+            for (size_t i = 0; i < Dim; i++)
+            {
+                T const *row = lower + internal::packedRowOffset(i);
+                double sum = 0;
+                for (size_t j = 0; j <= i; j++)
+                {
+                    sum += row[j] * m_whitened[j];
+                }
+                m_shifted[i] = sum;
+                value[i] = std::clamp(static_cast<T>(m_mean[i] + sum), m_lowerBounds[i], m_upperBounds[i]);
+            }
+        }
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void TruncatedMNVGenerator<T, Dim, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> const &TruncatedMNVGenerator<T, Dim, Engine>::lowerBounds() const
+    {
+        return m_lowerBounds;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> const &TruncatedMNVGenerator<T, Dim, Engine>::upperBounds() const
+    {
+        return m_upperBounds;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void TruncatedMNVGenerator<T, Dim, Engine>::seed(size_t seed)
+    {
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    Engine &TruncatedMNVGenerator<T, Dim, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<TruncatedMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    TruncatedMNVGenerator<T, Dim, Engine>::build(
+        MatrixSq<T, Dim> const &covariance,
+        valueVector<T, Dim> const &mean,
+        valueVector<T, Dim> const &lowerBounds,
+        valueVector<T, Dim> const &upperBounds,
+        size_t seed,
+        size_t sweepsPerValue,
+        size_t burnIn)
+    {
+        // 1. Check the box, NaN bounds fail the comparison as well
+
+        for (size_t i = 0; i < Dim; i++)
+        {
+            if (!(lowerBounds[i] < upperBounds[i]))
+            {
+                return MNVGeneratorBuildError{
+                    MNVGeneratorBuildError::type::BoundsAreNotValid,
+                    ERRMSG("Every lower bound must be less than its upper bound\n")};
+            }
+        }
+
+        // 2. Check for symmetric matrix
+
+        if (!internal::isMatrixSymmetric(covariance))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        // 3. Check for positive-definite matrix, the factor is kept for the generator
+
+        TruncatedMNVGenerator<T, Dim, Engine> generator{};
+        T *lower = generator.m_decomposedCovariance.data();
+        for (size_t i = 0; i < Dim; i++)
+        {
+            std::copy(covariance[i].begin(), covariance[i].begin() + static_cast<std::ptrdiff_t>(i) + 1, lower + internal::packedRowOffset(i));
+        }
+        if (!internal::tryCholetskyDecompositionInPlace(lower, Dim))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        generator.m_mean = mean;
+        generator.m_lowerBounds = lowerBounds;
+        generator.m_upperBounds = upperBounds;
+        generator.m_sweepsPerValue = std::max<size_t>(sweepsPerValue, 1);
+
+        // 4. Feasible starting point, row by row: x_i depends on z_i with a positive weight and on earlier z only,
+        // so z_i can always move it into its bounds. It stays where it is if already inside.
+
+        generator.m_whitened.resize(Dim);
+        generator.m_shifted.resize(Dim);
+        for (size_t i = 0; i < Dim; i++)
+        {
+            T const *row = lower + internal::packedRowOffset(i);
+            double partial = mean[i];
+            for (size_t j = 0; j < i; j++)
+            {
+                partial += row[j] * generator.m_whitened[j];
+            }
+
+            const double low = lowerBounds[i];
+            const double high = upperBounds[i];
+            double target = partial;
+            if (partial < low || partial > high)
+            {
+                if (std::isfinite(low) && std::isfinite(high))
+                {
+                    target = 0.5 * low + 0.5 * high;
+                }
+                else
+                {
+                    target = partial < low ? low + row[i] : high - row[i];
+                }
+            }
+
+            generator.m_whitened[i] = (target - partial) / row[i];
+            generator.m_shifted[i] = target - static_cast<double>(mean[i]);
+        }
+
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        generator.m_generator.seed(seed);
+
+        // 5. Move the chain away from the starting point
+
+        for (size_t sweep = 0; sweep < burnIn; sweep++)
+        {
+            internal::truncatedGibbsSweep(generator.m_generator, lower, mean.data(), lowerBounds.data(), upperBounds.data(),
+                                          Dim, generator.m_whitened.data(), generator.m_shifted.data());
+        }
+
+        return generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> MixtureMNVGenerator<T, Dim, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    size_t MixtureMNVGenerator<T, Dim, Engine>::nextComponent()
+    {
+        // one word picks the column and, with its fraction, whether the column or its alias is taken
+        const size_t columns = m_alias.size();
+        const double u = internal::uniformFromBits(internal::nextRandomBits(m_generator)) * static_cast<double>(columns);
+        const size_t column = std::min(static_cast<size_t>(u), columns - 1);
+        return u - static_cast<double>(column) < m_keep[column] ? column : m_alias[column];
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MixtureMNVGenerator<T, Dim, Engine>::nextValues(T *out, size_t count)
+    {
+        // values per component on average below which grouping does not pay, the transform works on 4 values at once
+        constexpr size_t groupedMinimum = 4;
+        const size_t factorSize = internal::packedRowOffset(Dim);
+
+        if (count < groupedMinimum * m_alias.size())
+        {
+            for (size_t k = 0; k < count; k++)
+            {
+                const size_t component = nextComponent();
+                T *value = out + k * Dim;
+                internal::fillStandardNormal(m_generator, value, Dim);
+                internal::transformStandardNormalVectors(m_factors.data() + component * factorSize, m_means.data() + component * Dim,
+                                                         Dim, value, 1);
+            }
+            return;
+        }
+
+        // 1. components of the whole batch, counted per distinct component
+        m_drawn.resize(count);
+        m_distinct.clear();
+        m_groupStart.assign(1, 0);
+        for (size_t k = 0; k < count; k++)
+        {
+            const size_t component = nextComponent();
+            m_drawn[k] = component;
+            if (m_groupOf[component] == noGroup)
+            {
+                m_groupOf[component] = m_distinct.size();
+                m_distinct.push_back(component);
+                m_groupStart.push_back(0);
+            }
+            m_groupStart[m_groupOf[component] + 1]++;
+        }
+        const size_t groups = m_distinct.size();
+        for (size_t g = 0; g < groups; g++)
+        {
+            m_groupStart[g + 1] += m_groupStart[g];
+        }
+
+        // 2. values grouped by component, stable
+        m_order.resize(count);
+        m_groupNext.assign(m_groupStart.begin(), m_groupStart.end() - 1);
+        for (size_t k = 0; k < count; k++)
+        {
+            m_order[m_groupNext[m_groupOf[m_drawn[k]]]++] = k;
+        }
+
+        // 3. normals for the batch at once, each group transformed by its own factor
+        m_buffer.resize(count * Dim);
+        internal::fillStandardNormal(m_generator, m_buffer.data(), m_buffer.size());
+        for (size_t g = 0; g < groups; g++)
+        {
+            const size_t component = m_distinct[g];
+            internal::transformStandardNormalVectors(m_factors.data() + component * factorSize, m_means.data() + component * Dim, Dim,
+                                                     m_buffer.data() + m_groupStart[g] * Dim, m_groupStart[g + 1] - m_groupStart[g]);
+            m_groupOf[component] = noGroup;
+        }
+
+        // 4. back to the order the components were drawn in
+        for (size_t p = 0; p < count; p++)
+        {
+            T const *value = m_buffer.data() + p * Dim;
+            std::copy(value, value + Dim, out + m_order[p] * Dim);
+        }
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MixtureMNVGenerator<T, Dim, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    size_t MixtureMNVGenerator<T, Dim, Engine>::componentCount() const
+    {
+        return m_alias.size();
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void MixtureMNVGenerator<T, Dim, Engine>::seed(size_t seed)
+    {
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    Engine &MixtureMNVGenerator<T, Dim, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<MixtureMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    MixtureMNVGenerator<T, Dim, Engine>::build(
+        std::vector<T> const &weights,
+        std::vector<MatrixSq<T, Dim>> const &covariances,
+        std::vector<valueVector<T, Dim>> const &means,
+        size_t seed)
+    {
+        // 1. Check the sizes and the weights
+
+        if (weights.empty() || weights.size() != covariances.size() || weights.size() != means.size())
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                ERRMSG("There must be a weight, a covariance matrix and a mean vector for every component, and at least one component\n")};
+        }
+
+        double totalWeight = 0;
+        for (T weight : weights)
+        {
+            if (!(weight >= 0) || !std::isfinite(weight))
+            {
+                return MNVGeneratorBuildError{
+                    MNVGeneratorBuildError::type::WeightsAreNotValid,
+                    ERRMSG("The weights must be non-negative and finite\n")};
+            }
+            totalWeight += static_cast<double>(weight);
+        }
+        if (!(totalWeight > 0) || !std::isfinite(totalWeight))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::WeightsAreNotValid,
+                ERRMSG("At least one weight must be positive, and their sum finite\n")};
+        }
+
+        // 2. Check every covariance matrix and keep its factor, zero-weight components are left out
+
+        MixtureMNVGenerator<T, Dim, Engine> generator{};
+        const size_t factorSize = internal::packedRowOffset(Dim);
+        std::vector<double> kept{};
+        for (size_t c = 0; c < weights.size(); c++)
+        {
+            if (!internal::isMatrixSymmetric(covariances[c]))
+            {
+                return MNVGeneratorBuildError{
+                    MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                    ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+            }
+
+            std::vector<T> factor(factorSize);
+            for (size_t i = 0; i < Dim; i++)
+            {
+                std::copy(covariances[c][i].begin(), covariances[c][i].begin() + static_cast<std::ptrdiff_t>(i) + 1, factor.data() + internal::packedRowOffset(i));
+            }
+            if (!internal::tryCholetskyDecompositionInPlace(factor.data(), Dim))
+            {
+                return MNVGeneratorBuildError{
+                    MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                    ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+            }
+
+            if (weights[c] > 0)
+            {
+                generator.m_factors.insert(generator.m_factors.end(), factor.begin(), factor.end());
+                generator.m_means.insert(generator.m_means.end(), means[c].begin(), means[c].end());
+                kept.push_back(static_cast<double>(weights[c]));
+            }
+        }
+
+        // 3. Alias table (Vose): columns below the average probability are topped up by ones above it
+
+        const size_t components = kept.size();
+        std::vector<double> scaled(components);
+        std::vector<size_t> small{};
+        std::vector<size_t> large{};
+        for (size_t c = 0; c < components; c++)
+        {
+            scaled[c] = kept[c] / totalWeight * static_cast<double>(components);
+            (scaled[c] < 1 ? small : large).push_back(c);
+        }
+
+        generator.m_keep.assign(components, 1.0);
+        generator.m_alias.resize(components);
+        for (size_t c = 0; c < components; c++)
+        {
+            generator.m_alias[c] = c;
+        }
+        while (!small.empty() && !large.empty())
+        {
+            const size_t below = small.back();
+            const size_t above = large.back();
+            small.pop_back();
+            large.pop_back();
+
+            generator.m_keep[below] = scaled[below];
+            generator.m_alias[below] = above;
+            scaled[above] -= 1 - scaled[below];
+            (scaled[above] < 1 ? small : large).push_back(above);
+        }
+        // the rest are full columns, up to rounding
+
+        generator.m_groupOf.assign(components, noGroup);
+
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        generator.m_generator.seed(seed);
+
+        return generator;
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    valueVector<T, Dim> FactorMNVGenerator<T, Dim, Factors, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    void FactorMNVGenerator<T, Dim, Factors, Engine>::nextValues(T *out, size_t count)
+    {
+        T const *common = m_normals.data();
+        T const *idiosyncratic = m_normals.data() + Factors;
+
+        for (size_t k = 0; k < count; k++)
+        {
+            internal::fillStandardNormal(m_generator, m_normals.data(), m_normals.size());
+
+            T *value = out + k * Dim;
+            for (size_t i = 0; i < Dim; i++)
+            {
+                T sum = m_mean[i];
+                for (size_t f = 0; f < Factors; f++)
+                {
+                    sum += m_loadings[i][f] * common[f];
+                }
+                value[i] = sum + m_idiosyncraticDeviations[i] * idiosyncratic[i];
+            }
+        }
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    void FactorMNVGenerator<T, Dim, Factors, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    void FactorMNVGenerator<T, Dim, Factors, Engine>::seed(size_t seed)
+    {
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    Engine &FactorMNVGenerator<T, Dim, Factors, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    MatrixSq<T, Dim> FactorMNVGenerator<T, Dim, Factors, Engine>::covariance() const
+    {
+        MatrixSq<T, Dim> result{};
+        for (size_t i = 0; i < Dim; i++)
+        {
+            for (size_t j = 0; j <= i; j++)
+            {
+                result[i][j] = internal::sumOfProductsUntil(m_loadings[i], m_loadings[j], Factors);
+                result[j][i] = result[i][j];
+            }
+            result[i][i] += m_idiosyncraticDeviations[i] * m_idiosyncraticDeviations[i];
+        }
+        return result;
+    }
+
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    std::variant<FactorMNVGenerator<T, Dim, Factors, Engine>, MNVGeneratorBuildError>
+    FactorMNVGenerator<T, Dim, Factors, Engine>::build(
+        MatrixRect<T, Dim, Factors> const &loadings,
+        valueVector<T, Dim> const &idiosyncraticVariances,
+        valueVector<T, Dim> const &mean,
+        size_t seed)
+    {
+        // loadings * loadings^T is symmetric and positive-semidefinite by construction,
+        // positive idiosyncratic variances are all it takes for a positive-definite covariance
+
+        valueVector<T, Dim> deviations{};
+        for (size_t i = 0; i < Dim; i++)
+        {
+            if (!(idiosyncraticVariances[i] > 0) || !std::isfinite(idiosyncraticVariances[i]))
+            {
+                return MNVGeneratorBuildError{
+                    MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                    ERRMSG("The idiosyncratic variances provided must be positive and finite, otherwise the covariance matrix is not positive-definite\n")};
+            }
+            deviations[i] = std::sqrt(idiosyncraticVariances[i]);
+        }
+
+        return FactorMNVGenerator<T, Dim, Factors, Engine>(loadings, deviations, mean, seed);
+    }
+
+    // private constructor is used to force FactorMNVGenerator::build()
+    template <typename T, size_t Dim, size_t Factors, typename Engine>
+    FactorMNVGenerator<T, Dim, Factors, Engine>::FactorMNVGenerator(MatrixRect<T, Dim, Factors> const &loadings,
+                                                                    valueVector<T, Dim> const &idiosyncraticDeviations,
+                                                                    valueVector<T, Dim> const &mean, size_t seed)
+        : m_loadings(loadings), m_idiosyncraticDeviations(idiosyncraticDeviations), m_mean(mean)
+    {
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim>
+    valueVector<T, Dim> QuasiMNVGenerator<T, Dim>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        nextValues(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    void QuasiMNVGenerator<T, Dim>::nextValues(T *out, size_t count)
+    {
+        // continues from the kept point, one direction per value instead of a rebuild
+        internal::fillQuasiStandardNormal(m_directions.data(), m_scrambles.data(), Dim, m_position, m_point.data(),
+                                          m_uniforms.data(), m_normals.data(), out, count);
+        internal::transformStandardNormalVectors(m_decomposedCovariance.data(), m_mean.data(), Dim, out, count);
+        m_position += count;
+    }
+
+    template <typename T, size_t Dim>
+    void QuasiMNVGenerator<T, Dim>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim>
+    void QuasiMNVGenerator<T, Dim>::valuesAt(std::uint64_t first, T *out, size_t count) const
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        std::vector<std::uint32_t> point(Dim);
+        std::vector<double> uniforms(Dim);
+        std::vector<double> normals(Dim);
+        internal::sobolPointAt(m_directions.data(), Dim, first, point.data());
+        internal::fillQuasiStandardNormal(m_directions.data(), m_scrambles.data(), Dim, first, point.data(),
+                                          uniforms.data(), normals.data(), out, count);
+        internal::transformStandardNormalVectors(m_decomposedCovariance.data(), m_mean.data(), Dim, out, count);
+    }
+
+    template <typename T, size_t Dim>
+    void QuasiMNVGenerator<T, Dim>::generateParallel(T *out, size_t count, size_t threads)
+    {
+        const std::uint64_t first = m_position;
+        m_position += count;
+
+        const size_t chunks = (count + internal::parallelChunkSize - 1) / internal::parallelChunkSize;
+        internal::runParallel(chunks, threads, [&](size_t chunk)
+                              {
+            const size_t offset = chunk * internal::parallelChunkSize;
+            valuesAt(first + offset, out + offset * Dim, std::min(internal::parallelChunkSize, count - offset)); });
+        internal::sobolPointAt(m_directions.data(), Dim, m_position, m_point.data());
+    }
+
+    template <typename T, size_t Dim>
+    void QuasiMNVGenerator<T, Dim>::discard(std::uint64_t count)
+    {
+        m_position += count;
+        internal::sobolPointAt(m_directions.data(), Dim, m_position, m_point.data());
+    }
+
+    template <typename T, size_t Dim>
+    std::uint64_t QuasiMNVGenerator<T, Dim>::position() const
+    {
+        return m_position;
+    }
+
+    template <typename T, size_t Dim>
+    void QuasiMNVGenerator<T, Dim>::seed(size_t seed)
+    {
+        for (size_t d = 0; d < Dim; d++)
+        {
+            m_scrambles[d] = static_cast<std::uint32_t>(internal::mixBits(static_cast<std::uint64_t>(seed) ^ internal::mixBits(d)));
+        }
+        m_position = 0;
+        std::fill(m_point.begin(), m_point.end(), std::uint32_t{0});
+    }
+
+    template <typename T, size_t Dim>
+    std::variant<QuasiMNVGenerator<T, Dim>, MNVGeneratorBuildError>
+    QuasiMNVGenerator<T, Dim>::build(
+        MatrixSq<T, Dim> const &covariance,
+        valueVector<T, Dim> const &mean,
+        size_t seed,
+        size_t threads)
+    {
+        // 1. Check for symmetric matrix
+
+        if (!internal::isMatrixSymmetric(covariance))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid covariance matrix.\n")};
+        }
+
+        // 2. Check for positive-definite matrix, the factor is kept for the generator
+
+        auto decomposed = std::make_unique<MatrixLowerTriangular<T, Dim>>();
+        if (!internal::tryCholetskyDecomposition(covariance, *decomposed, threads))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        return QuasiMNVGenerator<T, Dim>(*decomposed, mean, seed);
+    }
+
+    // private constructor is used to force QuasiMNVGenerator::build()
+    template <typename T, size_t Dim>
+    QuasiMNVGenerator<T, Dim>::QuasiMNVGenerator(MatrixLowerTriangular<T, Dim> const &decomposedCovariance, valueVector<T, Dim> const &mean, size_t seed)
+        : m_decomposedCovariance(decomposedCovariance), m_mean(mean), m_directions(internal::makeSobolDirections(Dim)), m_scrambles(Dim),
+          m_point(Dim), m_uniforms(Dim), m_normals(Dim)
+    {
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        this->seed(seed);
+    }
+
+    // The ring is indexed by running counters, slot = counter & mask. The consumer only writes m_head and the producer
+    // only writes m_tail, each on its own cache line. The mutex and condition variable are touched only to put the producer
+    // to sleep above the low watermark and to wake it up again, never on the consumer's fast path.
+    template <typename T, size_t Dim, typename Engine>
+    struct BufferedMNVGenerator<T, Dim, Engine>::State
+    {
+        // values the producer draws before publishing them, the consumer does not wait for a whole refill
+        static constexpr size_t producerChunk = 64;
+
+        State(MNVGenerator<T, Dim, Engine> &&wrapped, size_t requestedCapacity, size_t lowWatermark, size_t highWatermark)
+            : generator(std::move(wrapped))
+        {
+            size_t rounded = 2;
+            while (rounded < requestedCapacity)
+            {
+                rounded *= 2;
+            }
+            capacity = rounded;
+            high = std::clamp<size_t>(highWatermark, 1, rounded);
+            low = std::min(lowWatermark, high - 1);
+            ring = internal::makeAlignedBuffer<T>(rounded * Dim);
+            producer = std::thread([this]()
+                                   { produce(); });
+        }
+
+        ~State()
+        {
+            stop.store(true);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+            }
+            wakeUp.notify_one();
+            producer.join();
+        }
+
+        void produce()
+        {
+            std::uint64_t t = tail.load(std::memory_order_relaxed);
+            while (true)
+            {
+                // 1. fill up to the high watermark, chunk by chunk
+                for (std::uint64_t h = head.load(std::memory_order_acquire); t - h < high; h = head.load(std::memory_order_acquire))
+                {
+                    if (stop.load(std::memory_order_relaxed))
+                    {
+                        return;
+                    }
+                    const size_t slot = static_cast<size_t>(t) & (capacity - 1);
+                    const size_t count = std::min({static_cast<size_t>(high - (t - h)), producerChunk, capacity - slot});
+                    generator.nextValues(ring.get() + slot * Dim, count);
+                    t += count;
+                    tail.store(t, std::memory_order_release);
+                }
+
+                // 2. sleep until the consumer takes the ring down to the low watermark.
+                // The fence pairs with the one in wakeProducer(): either the consumer sees sleeping or we see its head.
+                std::unique_lock<std::mutex> lock(mutex);
+                sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                wakeUp.wait(lock, [&]()
+                            { return stop.load() || t - head.load(std::memory_order_acquire) <= low; });
+                sleeping.store(false, std::memory_order_relaxed);
+                if (stop.load())
+                {
+                    return;
+                }
+            }
+        }
+
+        void wakeProducer()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping.load(std::memory_order_relaxed))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                }
+                wakeUp.notify_one();
+            }
+        }
+
+        void consume(T *out, size_t count)
+        {
+            std::uint64_t h = head.load(std::memory_order_relaxed);
+            while (count > 0)
+            {
+                while (cachedTail == h)
+                {
+                    cachedTail = tail.load(std::memory_order_acquire);
+                    if (cachedTail == h)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+
+                const size_t slot = static_cast<size_t>(h) & (capacity - 1);
+                const size_t taken = std::min({count, static_cast<size_t>(cachedTail - h), capacity - slot});
+                std::copy(ring.get() + slot * Dim, ring.get() + (slot + taken) * Dim, out);
+                out += taken * Dim;
+                count -= taken;
+                h += taken;
+                head.store(h, std::memory_order_release);
+
+                // the cached tail only underestimates the level, refresh it before waking the producer
+                if (cachedTail - h <= low)
+                {
+                    cachedTail = tail.load(std::memory_order_acquire);
+                    if (cachedTail - h <= low)
+                    {
+                        wakeProducer();
+                    }
+                }
+            }
+        }
+
+        // consumer side
+        alignas(internal::cacheLineSize) std::atomic<std::uint64_t> head{0};
+        std::uint64_t cachedTail{0};
+
+        // producer side
+        alignas(internal::cacheLineSize) std::atomic<std::uint64_t> tail{0};
+        MNVGenerator<T, Dim, Engine> generator;
+
+        // sleep and wake-up of the producer
+        alignas(internal::cacheLineSize) std::atomic<bool> sleeping{false};
+        std::atomic<bool> stop{false};
+        std::mutex mutex{};
+        std::condition_variable wakeUp{};
+
+        internal::AlignedBuffer<T> ring{};
+        size_t capacity{0};
+        size_t low{0};
+        size_t high{0};
+        std::thread producer{};
+    };
+
+    template <typename T, size_t Dim, typename Engine>
+    valueVector<T, Dim> BufferedMNVGenerator<T, Dim, Engine>::nextValue()
+    {
+        valueVector<T, Dim> result{};
+        m_state->consume(result.data(), 1);
+        return result;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void BufferedMNVGenerator<T, Dim, Engine>::nextValues(T *out, size_t count)
+    {
+        m_state->consume(out, count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    void BufferedMNVGenerator<T, Dim, Engine>::nextValues(valueVector<T, Dim> *out, size_t count)
+    {
+        static_assert(sizeof(valueVector<T, Dim>) == sizeof(T) * Dim, "valueVector must be tightly packed");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        nextValues(out->data(), count);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    size_t BufferedMNVGenerator<T, Dim, Engine>::available() const
+    {
+        return static_cast<size_t>(m_state->tail.load(std::memory_order_acquire) - m_state->head.load(std::memory_order_relaxed));
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    size_t BufferedMNVGenerator<T, Dim, Engine>::capacity() const
+    {
+        return m_state->capacity;
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    std::variant<BufferedMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+    BufferedMNVGenerator<T, Dim, Engine>::build(
+        MatrixSq<T, Dim> const &covariance,
+        valueVector<T, Dim> const &mean,
+        size_t seed,
+        size_t capacity,
+        size_t lowWatermark,
+        size_t highWatermark)
+    {
+        auto generator = MNVGenerator<T, Dim, Engine>::build(covariance, mean, seed);
+        if (auto error = std::get_if<MNVGeneratorBuildError>(&generator))
+        {
+            return *error;
+        }
+
+        return build(std::get<MNVGenerator<T, Dim, Engine>>(std::move(generator)), capacity, lowWatermark, highWatermark);
+    }
+
+    template <typename T, size_t Dim, typename Engine>
+    BufferedMNVGenerator<T, Dim, Engine>
+    BufferedMNVGenerator<T, Dim, Engine>::build(
+        MNVGenerator<T, Dim, Engine> generator,
+        size_t capacity,
+        size_t lowWatermark,
+        size_t highWatermark)
+    {
+        return BufferedMNVGenerator<T, Dim, Engine>(
+            std::make_unique<State>(std::move(generator), capacity, lowWatermark, highWatermark));
+    }
+
+    // private constructor is used to force BufferedMNVGenerator::build()
+    template <typename T, size_t Dim, typename Engine>
+    BufferedMNVGenerator<T, Dim, Engine>::BufferedMNVGenerator(std::unique_ptr<State> state)
+        : m_state(std::move(state))
+    {
+    }
+
+    template <typename T, typename Engine>
+    std::vector<T> SparseMNVGenerator<T, Engine>::nextValue()
+    {
+        std::vector<T> result(m_dim);
+        nextValue(result.data());
+        return result;
+    }
+
+    template <typename T, typename Engine>
+    void SparseMNVGenerator<T, Engine>::nextValue(T *out)
+    {
+        nextValues(out, 1);
+    }
+
+    template <typename T, typename Engine>
+    void SparseMNVGenerator<T, Engine>::nextValues(T *out, size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // values are processed in batches stored component-major, so every nonzero of the factor
+        // is loaded once per batch and applied to all of its right-hand sides
+        const size_t batch = std::min(count, internal::sparseBatchSize);
+        m_normals.resize(m_dim);
+        if (m_block.size() < m_dim * batch)
+        {
+            m_block.resize(m_dim * batch);
+        }
+        T *normals = m_normals.data();
+        T *block = m_block.data();
+
+        for (size_t first = 0; first < count; first += batch)
+        {
+            const size_t rows = std::min(batch, count - first);
+
+            // drawn per value, so the engine is consumed the same way as by a single value
+            for (size_t b = 0; b < rows; b++)
+            {
+                internal::fillStandardNormal(m_generator, normals, m_dim);
+                for (size_t i = 0; i < m_dim; i++)
+                {
+                    block[i * batch + b] = normals[i];
+                }
+            }
+
+            if (m_isPrecision)
+            {
+                internal::sparseSolveTransposedInPlace(m_dim, m_factorRowOffsets.data(), m_factorColumns.data(), m_factorValues.data(),
+                                                       block, batch, rows);
+            }
+            else
+            {
+                internal::sparseMultiplyInPlace(m_dim, m_factorRowOffsets.data(), m_factorColumns.data(), m_factorValues.data(),
+                                                block, batch, rows);
+            }
+
+            for (size_t b = 0; b < rows; b++)
+            {
+                T *value = out + (first + b) * m_dim;
+                for (size_t i = 0; i < m_dim; i++)
+                {
+                    const size_t component = m_permutation[i];
+                    value[component] = m_mean[component] + block[i * batch + b];
+                }
+            }
+        }
+    }
+
+    template <typename T, typename Engine>
+    void SparseMNVGenerator<T, Engine>::seed(size_t seed)
+    {
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, typename Engine>
+    Engine &SparseMNVGenerator<T, Engine>::engine()
+    {
+        return m_generator;
+    }
+
+    template <typename T, typename Engine>
+    size_t SparseMNVGenerator<T, Engine>::dimension() const
+    {
+        return m_dim;
+    }
+
+    template <typename T, typename Engine>
+    size_t SparseMNVGenerator<T, Engine>::factorNonZeros() const
+    {
+        return m_factorValues.size();
+    }
+
+    template <typename T, typename Engine>
+    std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    SparseMNVGenerator<T, Engine>::build(
+        SparseMatrix<T> const &covariance,
+        std::vector<T> const &mean,
+        size_t seed,
+        SparseOrdering ordering)
+    {
+        return buildFactor(covariance, mean, seed, ordering, false);
+    }
+
+    template <typename T, typename Engine>
+    std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    SparseMNVGenerator<T, Engine>::buildFromPrecision(
+        SparseMatrix<T> const &precision,
+        std::vector<T> const &mean,
+        size_t seed,
+        SparseOrdering ordering)
+    {
+        return buildFactor(precision, mean, seed, ordering, true);
+    }
+
+    template <typename T, typename Engine>
+    std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    SparseMNVGenerator<T, Engine>::buildFactor(
+        SparseMatrix<T> const &matrix,
+        std::vector<T> const &mean,
+        size_t seed,
+        SparseOrdering ordering,
+        bool isPrecision)
+    {
+        if (!internal::isSparseMatrixValid(matrix) || mean.size() != matrix.dim)
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                ERRMSG("The sparse matrix provided is malformed or its dimension does not match mean.size().\n")};
+        }
+
+        // 1. Check for symmetric matrix
+
+        if (!internal::isSparseMatrixSymmetric(matrix))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric,
+                ERRMSG("The covariance (or precision) matrix provided is not symmetric. It's totally unsuitable to use here. Please provide a valid matrix.\n")};
+        }
+
+        // 2. Fill-reducing ordering, then the lower triangle of the permuted matrix by rows
+
+        const size_t dim = matrix.dim;
+        SparseMNVGenerator<T, Engine> generator(seed);
+        generator.m_isPrecision = isPrecision;
+        generator.m_dim = dim;
+        generator.m_mean = mean;
+        if (ordering == SparseOrdering::ReverseCuthillMcKee)
+        {
+            generator.m_permutation = internal::reverseCuthillMcKee(dim, matrix.rowOffsets.data(), matrix.columns.data());
+        }
+        else
+        {
+            generator.m_permutation.resize(dim);
+            for (size_t i = 0; i < dim; i++)
+            {
+                generator.m_permutation[i] = i;
+            }
+        }
+
+        std::vector<size_t> inverse(dim);
+        for (size_t i = 0; i < dim; i++)
+        {
+            inverse[generator.m_permutation[i]] = i;
+        }
+
+        std::vector<size_t> lowerOffsets(dim + 1, 0);
+        for (size_t i = 0; i < dim; i++)
+        {
+            for (size_t p = matrix.rowOffsets[i]; p < matrix.rowOffsets[i + 1]; p++)
+            {
+                lowerOffsets[inverse[i] + 1] += inverse[matrix.columns[p]] <= inverse[i];
+            }
+        }
+        for (size_t i = 0; i < dim; i++)
+        {
+            lowerOffsets[i + 1] += lowerOffsets[i];
+        }
+
+        std::vector<size_t> lowerColumns(lowerOffsets[dim]);
+        std::vector<T> lowerValues(lowerOffsets[dim]);
+        std::vector<size_t> next(lowerOffsets.begin(), lowerOffsets.end() - 1);
+        for (size_t i = 0; i < dim; i++)
+        {
+            for (size_t p = matrix.rowOffsets[i]; p < matrix.rowOffsets[i + 1]; p++)
+            {
+                const size_t column = inverse[matrix.columns[p]];
+                if (column <= inverse[i])
+                {
+                    const size_t position = next[inverse[i]]++;
+                    lowerColumns[position] = column;
+                    lowerValues[position] = matrix.values[p];
+                }
+            }
+        }
+
+        // 3. Check for positive-definite matrix, only the nonzeros of the factor are kept for the generator
+
+        if (!internal::trySparseCholetskyDecomposition(dim, lowerOffsets, lowerColumns, lowerValues,
+                                                       generator.m_factorRowOffsets, generator.m_factorColumns, generator.m_factorValues))
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite,
+                ERRMSG("The covariance (or precision) matrix provided is not positive-definite. It could be the wrong matrix or there's not enough values provided to construct the positive-definite one\n")};
+        }
+
+        return generator;
+    }
+
+    template <typename T, typename Engine>
+    std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+    SparseMNVGenerator<T, Engine>::build(
+        std::vector<T> const &lowerBands,
+        size_t bandwidth,
+        std::vector<T> const &mean,
+        size_t seed)
+    {
+        const size_t dim = mean.size();
+        const size_t rowLength = bandwidth + 1;
+        if (dim == 0 || lowerBands.size() != dim * rowLength)
+        {
+            return MNVGeneratorBuildError{
+                MNVGeneratorBuildError::type::DimensionsDoNotMatch,
+                ERRMSG("The band provided must have exactly mean.size() * (bandwidth + 1) elements.\n")};
+        }
+
+        // symmetric by construction, the upper half is mirrored from the lower one
+        SparseMatrix<T> covariance{};
+        covariance.dim = dim;
+        covariance.rowOffsets.reserve(dim + 1);
+        covariance.rowOffsets.push_back(0);
+        for (size_t i = 0; i < dim; i++)
+        {
+            const size_t first = i > bandwidth ? i - bandwidth : 0;
+            const size_t last = std::min(dim - 1, i + bandwidth);
+            for (size_t j = first; j <= last; j++)
+            {
+                covariance.columns.push_back(j);
+                covariance.values.push_back(j <= i ? lowerBands[i * rowLength + j + bandwidth - i]
+                                                   : lowerBands[j * rowLength + i + bandwidth - j]);
+            }
+            covariance.rowOffsets.push_back(covariance.columns.size());
+        }
+
+        return build(covariance, mean, seed, SparseOrdering::Natural);
+    }
+
+    // private constructor is used to force SparseMNVGenerator::build()
+    template <typename T, typename Engine>
+    SparseMNVGenerator<T, Engine>::SparseMNVGenerator(size_t seed)
+    {
+        if (seed == 0)
+        {
+            std::random_device rd{};
+            seed = rd();
+        }
+        m_seed = seed;
+        m_generator.seed(seed);
+    }
+
+    template <typename T, size_t Dim>
+    constexpr CovarianceFactor<T, Dim> makeCovarianceFactor(MatrixSq<T, Dim> const &covariance)
+    {
+        CovarianceFactor<T, Dim> result{};
+
+        if (!internal::isMatrixSymmetric(covariance))
+        {
+            result.error = MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric;
+            return result;
+        }
+
+        if (!internal::tryCholetskyDecompositionConstexpr(covariance, result.lower))
+        {
+            result.lower = {};
+            result.error = MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite;
+            return result;
+        }
+
+        result.valid = true;
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    void CovarianceAccumulator<T, Dim>::add(valueVector<T, Dim> const &sample)
+    {
+        m_count++;
+        const T n = static_cast<T>(m_count);
+
+        valueVector<T, Dim> delta{};
+        for (size_t i = 0; i < Dim; i++)
+        {
+            delta[i] = sample[i] - m_mean[i];
+            m_mean[i] += delta[i] / n;
+        }
+
+        // Welford: comoment += (n - 1) / n * delta * delta^T
+        const T weight = (n - 1) / n;
+        for (size_t i = 0; i < Dim; i++)
+        {
+            T *row = m_comoment.data() + internal::packedRowOffset(i);
+            const T scaled = weight * delta[i];
+            for (size_t j = 0; j <= i; j++)
+            {
+                row[j] += scaled * delta[j];
+            }
+        }
+    }
+
+    template <typename T, size_t Dim>
+    void CovarianceAccumulator<T, Dim>::add(valueVector<T, Dim> const *samples, size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // exact two-pass statistics of the batch, then merged in
+        CovarianceAccumulator<T, Dim> batch{};
+        batch.m_count = count;
+
+        for (size_t k = 0; k < count; k++)
+        {
+            for (size_t i = 0; i < Dim; i++)
+            {
+                batch.m_mean[i] += samples[k][i];
+            }
+        }
+        for (size_t i = 0; i < Dim; i++)
+        {
+            batch.m_mean[i] /= static_cast<T>(count);
+        }
+
+        valueVector<T, Dim> centered{};
+        for (size_t k = 0; k < count; k++)
+        {
+            for (size_t i = 0; i < Dim; i++)
+            {
+                centered[i] = samples[k][i] - batch.m_mean[i];
+            }
+
+            for (size_t i = 0; i < Dim; i++)
+            {
+                T *row = batch.m_comoment.data() + internal::packedRowOffset(i);
+                for (size_t j = 0; j <= i; j++)
+                {
+                    row[j] += centered[i] * centered[j];
+                }
+            }
+        }
+
+        merge(batch);
+    }
+
+    template <typename T, size_t Dim>
+    void CovarianceAccumulator<T, Dim>::add(std::vector<valueVector<T, Dim>> const &samples)
+    {
+        add(samples.data(), samples.size());
+    }
+
+    template <typename T, size_t Dim>
+    void CovarianceAccumulator<T, Dim>::merge(CovarianceAccumulator<T, Dim> const &other)
+    {
+        if (other.m_count == 0)
+        {
+            return;
+        }
+
+        if (m_count == 0)
+        {
+            *this = other;
+            return;
+        }
+
+        const T countA = static_cast<T>(m_count);
+        const T countB = static_cast<T>(other.m_count);
+        const T total = countA + countB;
+
+        valueVector<T, Dim> delta{};
+        for (size_t i = 0; i < Dim; i++)
+        {
+            delta[i] = other.m_mean[i] - m_mean[i];
+            m_mean[i] += delta[i] * countB / total;
+        }
+
+        // Chan et al.: comoment = comomentA + comomentB + countA * countB / total * delta * delta^T
+        const T weight = countA * countB / total;
+        for (size_t i = 0; i < Dim; i++)
+        {
+            T *row = m_comoment.data() + internal::packedRowOffset(i);
+            T const *otherRow = other.m_comoment.data() + internal::packedRowOffset(i);
+            const T scaled = weight * delta[i];
+            for (size_t j = 0; j <= i; j++)
+            {
+                row[j] += otherRow[j] + scaled * delta[j];
+            }
+        }
+
+        m_count += other.m_count;
+    }
+
+    template <typename T, size_t Dim>
+    size_t CovarianceAccumulator<T, Dim>::count() const
+    {
+        return m_count;
+    }
+
+    template <typename T, size_t Dim>
+    valueVector<T, Dim> CovarianceAccumulator<T, Dim>::mean() const
+    {
+        return m_mean;
+    }
+
+    template <typename T, size_t Dim>
+    MatrixSq<T, Dim> CovarianceAccumulator<T, Dim>::covariance() const
+    {
+        MatrixSq<T, Dim> result{};
+        if (m_count < 2)
+        {
+            return result;
+        }
+
+        const T denominator = static_cast<T>(m_count) - 1;
+        for (size_t i = 0; i < Dim; i++)
+        {
+            T const *row = m_comoment.data() + internal::packedRowOffset(i);
+            for (size_t j = 0; j <= i; j++)
+            {
+                result[i][j] = row[j] / denominator;
+                result[j][i] = result[i][j];
+            }
+        }
+
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    valueVector<T, Dim> calculateMeanVector(std::vector<valueVector<T, Dim>> const &inputVectors)
+    {
+        valueVector<T, Dim> result{};
+
+        for (auto &&vec : inputVectors)
+        {
+            result = internal::addVectors(result, vec);
+        }
+
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            result[i] /= static_cast<T>(inputVectors.size());
+        }
+
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    MatrixSq<T, Dim> calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &inputVectors, size_t threads)
+    {
+        MatrixSq<T, Dim> result{};
+        calculateCovarianceMatrix(inputVectors, result, threads);
+        return result;
+    }
+
+    template <typename T, size_t Dim>
+    void calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &inputVectors, MatrixSq<T, Dim> &result, size_t threads)
+    {
+        valueVector<T, Dim> mean = calculateMeanVector(inputVectors);
+
+        // every part gets a fixed contiguous range of samples and its own accumulator,
+        // partial sums are added up in order, so the result depends on the thread count only
+        const size_t count = inputVectors.size();
+        const size_t blocks = (count + internal::covarianceBlockRows - 1) / internal::covarianceBlockRows;
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        const size_t parts = std::max<size_t>(1, std::min(threads, blocks));
+
+        constexpr size_t packedSize = Dim * (Dim + 1) / 2;
+        std::vector<T> partials(parts * packedSize);
+        internal::runParallel(parts, parts, [&](size_t part)
+                              {
+            const size_t first = std::min(count, blocks * part / parts * internal::covarianceBlockRows);
+            const size_t last = std::min(count, blocks * (part + 1) / parts * internal::covarianceBlockRows);
+            internal::accumulateCenteredProducts(inputVectors.data(), mean, first, last, partials.data() + part * packedSize); });
+
+        for (size_t part = 1; part < parts; part++)
+        {
+            for (size_t i = 0; i < packedSize; i++)
+            {
+                partials[i] += partials[part * packedSize + i];
+            }
+        }
+
+        const T denominator = static_cast<T>(count) - 1;
+        for (size_t i = 0; i < Dim; i++)
+        {
+            T const *row = partials.data() + internal::packedRowOffset(i);
+            for (size_t j = 0; j <= i; j++)
+            {
+                result[i][j] = row[j] / denominator;
+                result[j][i] = result[i][j];
+            }
+        }
     }
 } // namespace mnv
 
@@ -4,8 +4,12 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdint>
+#include <iosfwd>
 #include <memory>
+#include <optional>
 #include <random>
+#include <string>
 #include <string_view>
 #include <variant>
 #include <vector>
@@ -51,6 +55,26 @@ namespace mnv
     template <typename T, size_t Dim>
     using MatrixSq = valueVector<valueVector<T, Dim>, Dim>;
 
+    /**
+     * @brief Rectangular matrix, array of Rows arrays of Cols elements, size is statically defined
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Rows Row count
+     * @tparam Cols Column count
+     */
+    template <typename T, size_t Rows, size_t Cols>
+    using MatrixRect = valueVector<valueVector<T, Cols>, Rows>;
+
+    /**
+     * @brief Lower-triangular matrix in packed form, only Dim * (Dim + 1) / 2 elements are stored.
+     * Rows are stored one after another, row i starts at element i * (i + 1) / 2 and holds i + 1 elements.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Matrix size
+     */
+    template <typename T, size_t Dim>
+    using MatrixLowerTriangular = valueVector<T, Dim * (Dim + 1) / 2>;
+
     /**
      * @brief Struct to signal, that the generator build process was failed
      *
@@ -65,6 +89,11 @@ namespace mnv
         {
             CovarianceMatrixIsNotPositiveDefinite,
             CovarianceMatrixIsNotSymmetric,
+            DimensionsDoNotMatch,
+            SnapshotIsNotValid,
+            BoundsAreNotValid,
+            WeightsAreNotValid,
+            DecayIsOutOfRange,
         };
         /**
          * @brief Field that holds the error type
@@ -80,14 +109,244 @@ namespace mnv
 #endif
     };
 
+    /**
+     * @brief Choletsky factor of a covariance matrix, made by makeCovarianceFactor().
+     * A literal type, so a factor computed in a constant expression can be stored as static constexpr data
+     * and MNVGenerator::build() from it costs no validation or decomposition at startup.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Matrix size
+     */
+    template <typename T, size_t Dim>
+    struct CovarianceFactor
+    {
+        MatrixLowerTriangular<T, Dim> lower{}; // packed lower-triangular factor, zeros if not valid
+        bool valid{false};
+        enum MNVGeneratorBuildError::type error{MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite}; // meaningful only if not valid
+    };
+
+    /**
+     * @brief Validates and decomposes a covariance matrix, usable in constant expressions.
+     * Performs the same symmetry and positive-definiteness checks as MNVGenerator::build().
+     * The square root is computed by Newton-Raphson, so the factor may differ from the runtime one in the last bit.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Matrix size
+     * @param covariance Covariance matrix
+     * @return CovarianceFactor<T, Dim> The factor, check valid before use
+     */
+    template <typename T, size_t Dim>
+    constexpr CovarianceFactor<T, Dim> makeCovarianceFactor(MatrixSq<T, Dim> const &covariance);
+
+    namespace internal
+    {
+        template <typename T, size_t Dim>
+        constexpr CovarianceFactor<T, Dim> requireValidFactor(CovarianceFactor<T, Dim> const &factor);
+    } // namespace internal
+
+    /**
+     * @brief Factor of a covariance matrix with static storage duration, always computed at compile time.
+     * An invalid matrix is a compile error, naming internal::covarianceMatrixIsNotSymmetric() or
+     * internal::covarianceMatrixIsNotPositiveDefinite().
+     *
+     * Example: \n
+     * static constexpr mnv::MatrixSq<double, 2> covariance{{{2, 1}, {1, 2}}}; \n
+     * auto gen = mnv::MNVGenerator<double, 2>::build(mnv::staticCovarianceFactor<covariance>, mean);
+     *
+     * @tparam Covariance Covariance matrix, a constexpr object with static storage duration
+     */
+    template <auto const &Covariance>
+    inline constexpr auto staticCovarianceFactor = internal::requireValidFactor(makeCovarianceFactor(Covariance));
+
+    /**
+     * @brief Counter-based Philox4x32-10 random bit generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+     * The state is a 128-bit counter and a 64-bit key, so the engine is cheap to copy,
+     * discard() is O(1) and 2^64 independent streams of 2^66 values are available for every seed.
+     * Satisfies the UniformRandomBitGenerator requirements and can be used as the MNVGenerator engine.
+     *
+     */
+    class Philox4x32
+    {
+    public:
+        /**
+         * @brief Type of generated values, every value is a uniformly distributed 32-bit word
+         *
+         */
+        using result_type = std::uint32_t;
+
+        /**
+         * @brief Smallest value generated
+         *
+         */
+        static constexpr result_type min() { return 0; }
+
+        /**
+         * @brief Largest value generated
+         *
+         */
+        static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+        /**
+         * @brief Default seed, the one std::mt19937 uses as well
+         *
+         */
+        static constexpr std::uint64_t default_seed = 5489u;
+
+        /**
+         * @brief Construct the engine with the default seed at the start of stream 0
+         *
+         */
+        Philox4x32();
+
+        /**
+         * @brief Construct the engine at the start of the given stream
+         *
+         * @param seed Key of the generator
+         * @param stream Stream index, streams with the same seed do not overlap
+         */
+        explicit Philox4x32(std::uint64_t seed, std::uint64_t stream = 0);
+
+        /**
+         * @brief Set a new key and rewind to the start of stream 0
+         *
+         * @param seed A new seed
+         */
+        void seed(std::uint64_t seed = default_seed);
+
+        /**
+         * @brief Rewind to the start of the given stream, the key is kept
+         *
+         * @param stream Stream index
+         */
+        void stream(std::uint64_t stream);
+
+        /**
+         * @brief Generate the next value
+         *
+         * @return result_type Uniformly distributed 32-bit word
+         */
+        result_type operator()();
+
+        /**
+         * @brief Skip the next count values in O(1)
+         *
+         * @param count Amount of values to skip
+         */
+        void discard(unsigned long long count);
+
+        /**
+         * @brief Engines are equal when they will generate the same values
+         *
+         */
+        friend bool operator==(Philox4x32 const &lhs, Philox4x32 const &rhs);
+
+        /**
+         * @brief Engines are not equal when they will generate different values
+         *
+         */
+        friend bool operator!=(Philox4x32 const &lhs, Philox4x32 const &rhs);
+
+        /**
+         * @brief Write the engine state as text, as the standard engines do
+         *
+         */
+        friend std::ostream &operator<<(std::ostream &out, Philox4x32 const &engine);
+
+        /**
+         * @brief Restore the engine state written by operator<<
+         *
+         */
+        friend std::istream &operator>>(std::istream &in, Philox4x32 &engine);
+
+    private:
+        void generateBlock();
+
+        // counter words 0-1 are the block index, words 2-3 are the stream index
+        std::array<std::uint32_t, 4> m_counter{};
+        std::array<std::uint32_t, 2> m_key{};
+        std::array<std::uint32_t, 4> m_block{};
+        size_t m_position{4}; // next word of m_block to return, 4 means the block must be generated
+    };
+
+    /**
+     * @brief Single-pass mean and covariance estimation, samples are never stored.
+     * Uses Welford updates for single samples and Chan et al. pairwise combination for batches and merge(),
+     * so partial accumulators from different threads or files can be combined into the same result.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Vectors' size
+     */
+    template <typename T, size_t Dim>
+    class CovarianceAccumulator
+    {
+    public:
+        /**
+         * @brief Account for a single sample
+         *
+         * @param sample The sample
+         */
+        void add(valueVector<T, Dim> const &sample);
+
+        /**
+         * @brief Account for count samples stored one after another
+         *
+         * @param samples Pointer to the first sample
+         * @param count Amount of samples
+         */
+        void add(valueVector<T, Dim> const *samples, size_t count);
+
+        /**
+         * @brief Account for a batch of samples
+         *
+         * @param samples The samples
+         */
+        void add(std::vector<valueVector<T, Dim>> const &samples);
+
+        /**
+         * @brief Account for all samples accumulated by other, as if they were added to this accumulator
+         *
+         * @param other Partial accumulator
+         */
+        void merge(CovarianceAccumulator<T, Dim> const &other);
+
+        /**
+         * @brief Amount of samples accounted for
+         *
+         */
+        size_t count() const;
+
+        /**
+         * @brief Mean vector of the samples accounted for
+         *
+         */
+        valueVector<T, Dim> mean() const;
+
+        /**
+         * @brief Sample covariance matrix (normalized by count - 1, like calculateCovarianceMatrix()).
+         * A zero matrix is returned for less than two samples.
+         *
+         */
+        MatrixSq<T, Dim> covariance() const;
+
+    private:
+        size_t m_count{0};
+        valueVector<T, Dim> m_mean{};
+        // sum of (x - mean) (x - mean)^T over the samples, lower triangle packed
+        MatrixLowerTriangular<T, Dim> m_comoment{};
+    };
+
     /**
      * @brief The main Generator class. It incapsulates the internal rng state and distribution parameters
      *
+     * Standard normal values are produced by the library's own ziggurat sampler on top of the engine,
+     * so the generated sequence for a given seed is the same with every compiler and standard library.
      *
      * @tparam T Type of values generated
      * @tparam Dim Dimension count of values
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default. \n
+     *         Use mnv::Philox4x32 for a small generator with O(1) discard() and stream selection.
      */
-    template <typename T, size_t Dim>
+    template <typename T, size_t Dim, typename Engine = std::mt19937>
     class MNVGenerator
     {
     public:
@@ -99,19 +358,208 @@ namespace mnv
         valueVector<T, Dim> nextValue();
 
         /**
-         * @brief Set a new seed for internal rng
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * Standard normal values are drawn for the whole block first and then transformed in place,
+         * which is much faster than calling nextValue() in a loop.
+         * The result is bit-identical to count consecutive nextValue() calls.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Generate count next values of rng as antithetic pairs mean + L * z, mean - L * z.
+         * Each pair costs one set of standard normals and one transform, half of what nextValues() spends.
+         * The pair members are perfectly negatively correlated, so averages over whole pairs have lower variance.
+         * An odd count ends with the first value of a pair.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextAntitheticValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values of rng as antithetic pairs.
+         * Same as nextAntitheticValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextAntitheticValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Generate a moment-matched batch of count values: the batch is rescaled so that its sample mean
+         * is exactly the mean and its sample covariance (divided by count - 1) is exactly the covariance, up to rounding.
+         * Costs one extra pass over the batch and O(Dim^3) per call.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate, MUST be greater than Dim
+         * @return std::optional<MNVGeneratorBuildError> Error if count is too small for the batch covariance
+         *         to be positive-definite, out is unspecified in that case.
+         */
+        std::optional<MNVGeneratorBuildError> nextMomentMatchedValues(T *out, size_t count);
+
+        /**
+         * @brief Generate a moment-matched batch of count values.
+         * Same as nextMomentMatchedValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate, MUST be greater than Dim
+         * @return std::optional<MNVGeneratorBuildError> Error if count is too small for the batch covariance
+         *         to be positive-definite, out is unspecified in that case.
+         */
+        std::optional<MNVGeneratorBuildError> nextMomentMatchedValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Generate count values on several threads straight into the caller's buffer.
+         * The values are split into fixed-size chunks, each drawn from its own independent substream
+         * derived from the seed, and the chunks are shared out between the threads. The output therefore
+         * depends only on the seed and on the sizes of the previous generateParallel() calls, never on threads.
+         * The substreams are independent of the sequence produced by nextValue(), which is left untouched.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         * @param threads Amount of threads to use, the calling one included. 0 means std::thread::hardware_concurrency()
+         */
+        void generateParallel(T *out, size_t count, size_t threads = 0);
+
+        /**
+         * @brief Generate count values on several threads straight into the caller's buffer.
+         * Same as generateParallel(T *, size_t, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         * @param threads Amount of threads to use, the calling one included. 0 means std::thread::hardware_concurrency()
+         */
+        void generateParallel(valueVector<T, Dim> *out, size_t count, size_t threads = 0);
+
+        /**
+         * @brief Set a new seed for internal rng, generateParallel() substreams restart from the new seed as well
          *
          * @param seed A new seed
          */
         void seed(size_t seed);
 
+        /**
+         * @brief Access the internal rng, e.g. to select a stream or discard() values of a counter-based engine
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Rank-1 update of the distribution: covariance becomes covariance + v * v^T.
+         * The Choletsky factor is updated in O(Dim^2), no rebuild is needed.
+         *
+         * @param v Vector
+         */
+        void update(valueVector<T, Dim> const &v);
+
+        /**
+         * @brief Rank-1 downdate of the distribution: covariance becomes covariance - v * v^T, in O(Dim^2).
+         *
+         * @param v Vector
+         * @return std::optional<MNVGeneratorBuildError> Error if the result would not be positive-definite,
+         *         the generator is left unchanged in that case.
+         */
+        std::optional<MNVGeneratorBuildError> downdate(valueVector<T, Dim> const &v);
+
+        /**
+         * @brief Exponentially weighted update with a new observation, in O(Dim^2):
+         * mean = decay * mean + (1 - decay) * value,
+         * covariance = decay * covariance + decay * (1 - decay) * (value - previous mean) * (value - previous mean)^T
+         *
+         * @param value Observation
+         * @param decay Weight of the distribution so far, within (0, 1]
+         * @return std::optional<MNVGeneratorBuildError> DecayIsOutOfRange if decay is out of range, the generator is left unchanged in that case.
+         */
+        std::optional<MNVGeneratorBuildError> observe(valueVector<T, Dim> const &value, T decay);
+
+        /**
+         * @brief Log-density of the distribution at x. Uses the stored Choletsky factor and the log-determinant
+         * cached at build, so it costs one forward substitution, O(Dim^2).
+         *
+         * @param x Point
+         * @return T log N(x | mean, covariance)
+         */
+        T logPdf(valueVector<T, Dim> const &x) const;
+
+        /**
+         * @brief Log-density of the distribution at count points. The points are solved against the factor in blocks,
+         * with the block of points as the innermost, vectorized loop.
+         *
+         * @param points count * Dim elements, points are stored one after another
+         * @param count Amount of points
+         * @param out Buffer of at least count elements
+         */
+        void logPdf(T const *points, size_t count, T *out) const;
+
+        /**
+         * @brief Mahalanobis distance sqrt((x - mean)^T covariance^-1 (x - mean)) of x, O(Dim^2)
+         *
+         * @param x Point
+         * @return T Distance
+         */
+        T mahalanobis(valueVector<T, Dim> const &x) const;
+
+        /**
+         * @brief Mahalanobis distances of count points, blocked as logPdf(T const *, size_t, T *) const
+         *
+         * @param points count * Dim elements, points are stored one after another
+         * @param count Amount of points
+         * @param out Buffer of at least count elements
+         */
+        void mahalanobis(T const *points, size_t count, T *out) const;
+
+        /**
+         * @brief Write a binary snapshot of the generator: the Choletsky factor, the mean, the seed and the engine state.
+         * The snapshot format is shared with DynamicMNVGenerator, see SnapshotFile. Check out's state for write errors.
+         *
+         * @param out Binary stream
+         */
+        void save(std::ostream &out) const;
+
+        /**
+         * @brief Constructor from a snapshot written by save(), no validation or decomposition is repeated.
+         * The generator continues exactly where the saved one was.
+         *
+         * @param data Snapshot bytes
+         * @param size Snapshot size in bytes
+         * @return std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If the snapshot is damaged, of another version, type or byte order, variant will contain SnapshotIsNotValid. \n
+         *          If it was saved for another dimension, DimensionsDoNotMatch. \n
+         *          Else, there will be an instance of MNVGenerator.
+         */
+        static std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        load(void const *data, size_t size);
+
+        /**
+         * @brief Constructor from a snapshot written by save(), see load(void const *, size_t)
+         *
+         * @param in Binary stream, read to its end
+         * @return std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> Generator or error
+         */
+        static std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        load(std::istream &in);
+
         /**
          * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
          *
          * @param covariance Covariance matrix. MUST be positive-definite and symmetric.
          * @param mean Mean vector.
          * @param seed Internal rng seed.
-         * @return std::variant<MNVGenerator<T, Dim>, MNVGeneratorBuildError> \n
+         * @param threads Amount of threads used to factor the covariance matrix, only matters for large dimensions.
+         * @return std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
          *          If error happened, variant will contain MNVGeneratorBuildError. \n
          *          Else, there will be an instance of MNVGenerator. \n
          *          To properly check for errors, you should always check with std::holds_alternative<mnv::MNVGeneratorBuildError>() \n
@@ -119,18 +567,19 @@ namespace mnv
          *          See also <a href="https://en.cppreference.com/w/cpp/utility/variant">std::variant [cppreference.com]</a> \n
          *          You can also check tests and examples for usage.
          */
-        static std::variant<MNVGenerator<T, Dim>, MNVGeneratorBuildError>
+        static std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
         build(
             MatrixSq<T, Dim> const &covariance,
             valueVector<T, Dim> const &mean,
-            size_t seed = 0);
+            size_t seed = 0,
+            size_t threads = 1);
 
         /**
          * @brief Alternative constructor, in case you have raw values instead of ready-to-use distribution params
          *
          * @param statisticVectors Raw statistics
          * @param seed Internal rng seed
-         * @return std::variant<MNVGenerator<T, Dim>, MNVGeneratorBuildError> \n
+         * @return std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
          *          If error happened, variant will contain MNVGeneratorBuildError. \n
          *          Else, there will be an instance of MNVGenerator. \n
          *          To properly check for errors, you should always check with std::holds_alternative<mnv::MNVGeneratorBuildError>() \n
@@ -138,35 +587,1422 @@ namespace mnv
          *          See also <a href="https://en.cppreference.com/w/cpp/utility/variant">std::variant [cppreference.com]</a> \n
          *          You can also check tests and examples for usage.
          */
-        static std::variant<MNVGenerator<T, Dim>, MNVGeneratorBuildError>
+        static std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
         build(
             std::vector<valueVector<T, Dim>> const &statisticVectors,
             size_t seed = 0);
 
+        /**
+         * @brief Alternative constructor, in case the statistics were accumulated incrementally
+         *
+         * @param statistics Accumulated raw statistics
+         * @param seed Internal rng seed
+         * @return std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of MNVGenerator.
+         */
+        static std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        build(
+            CovarianceAccumulator<T, Dim> const &statistics,
+            size_t seed = 0);
+
+        /**
+         * @brief Constructor from a ready factor, e.g. a static constexpr one made by makeCovarianceFactor() at compile time.
+         * No validation or decomposition is done, the checks were made along with the factor.
+         *
+         * @param factor Choletsky factor of the covariance matrix
+         * @param mean Mean vector.
+         * @param seed Internal rng seed.
+         * @return std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If the factor is not valid, variant will contain its MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of MNVGenerator.
+         */
+        static std::variant<MNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        build(
+            CovarianceFactor<T, Dim> const &factor,
+            valueVector<T, Dim> const &mean,
+            size_t seed = 0);
+
     private:
         // private constructor is used to force MNVGenerator::build()
-        MNVGenerator(MatrixSq<T, Dim> decomposedCovariance, valueVector<T, Dim> mean, size_t seed);
+        MNVGenerator(MatrixLowerTriangular<T, Dim> const &decomposedCovariance, valueVector<T, Dim> const &mean, size_t seed);
 
-        // distribution params
-        MatrixSq<T, Dim> m_decomposedCovariance{};
+        // distribution params, the Choletsky factor is stored packed
+        MatrixLowerTriangular<T, Dim> m_decomposedCovariance{};
         valueVector<T, Dim> m_mean{};
+        T m_logDeterminant{}; // of the covariance, kept up to date by update(), downdate() and observe()
 
         // rng params
         size_t m_seed{0};
-        std::mt19937 m_generator{};
-        std::normal_distribution<T> distribution{0, 1};
+        Engine m_generator{};
+        std::uint64_t m_nextSubstream{0}; // first substream of the next generateParallel() call
     };
 
+    namespace internal
+    {
+        template <typename T>
+        struct AlignedDeleter;
+    } // namespace internal
+
     /**
-     * @brief Function to statistically calculate covariance matrix using statistic data
+     * @brief Read-only view of a generator snapshot file written by MNVGenerator::save() or DynamicMNVGenerator::save().
+     * Where available (POSIX) the file is memory-mapped, so the pages of the Choletsky factor are shared
+     * by every process mapping the same file. Elsewhere, or with MNV_DISABLE_MMAP defined, the file is read into memory.
      *
-     * @tparam T Underlying type, supposedly float/decimal
-     * @tparam Dim Matrix size
-     * @param input_vectors Input vectors to calculate covariance matrix
-     * @return MatrixSq<T, Dim> The covariance matrix
+     * Snapshot layout, native byte order: a 64-byte header (magic "MNVSNAP", format version, scalar size,
+     * byte order mark, dimension, seed, generateParallel() position, engine state size), the packed Choletsky factor
+     * padded to a cache line, the mean padded to a cache line, and the engine state as text.
+     * The factor and the mean have the same layout as in DynamicMNVGenerator, which can use them in place.
+     */
+    class SnapshotFile
+    {
+    public:
+        /**
+         * @brief Map the file read-only
+         *
+         * @param path Path to a snapshot file
+         * @return std::variant<SnapshotFile, MNVGeneratorBuildError> \n
+         *          If the file can not be opened, variant will contain SnapshotIsNotValid. \n
+         *          Else, there will be an instance of SnapshotFile. The contents are validated on load.
+         */
+        static std::variant<SnapshotFile, MNVGeneratorBuildError> open(std::string const &path);
+
+        /**
+         * @brief First byte of the snapshot, aligned to at least a cache line
+         *
+         */
+        void const *data() const;
+
+        /**
+         * @brief Snapshot size in bytes
+         *
+         */
+        size_t size() const;
+
+        SnapshotFile(SnapshotFile &&other) noexcept;
+        SnapshotFile &operator=(SnapshotFile &&other) noexcept;
+        SnapshotFile(SnapshotFile const &) = delete;
+        SnapshotFile &operator=(SnapshotFile const &) = delete;
+        ~SnapshotFile();
+
+    private:
+        SnapshotFile() = default;
+
+        void const *m_data{nullptr};
+        size_t m_size{0};
+        bool m_mapped{false}; // munmap() or operator delete on destruction
+    };
+
+    /**
+     * @brief Generator for a dimension chosen at runtime.
+     * The Choletsky factor and the mean live in a single contiguous cache-aligned heap buffer,
+     * so generators of any size are cheap to move and never touch the stack. Copying is disabled.
+     * Build, validation and sampling share their kernels with MNVGenerator, the same covariance,
+     * mean, seed and engine give bit-identical values.
+     *
+     * @tparam T Type of values generated
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default
+     */
+    template <typename T, typename Engine = std::mt19937>
+    class DynamicMNVGenerator
+    {
+    public:
+        /**
+         * @brief Generate the next value of rng.
+         *
+         * @return std::vector<T> Generated value
+         */
+        std::vector<T> nextValue();
+
+        /**
+         * @brief Generate the next value of rng straight into the caller's buffer.
+         *
+         * @param out Buffer of at least dimension() elements
+         */
+        void nextValue(T *out);
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * The result is bit-identical to count consecutive nextValue() calls.
+         *
+         * @param out Buffer of at least count * dimension() elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values of rng as antithetic pairs, see MNVGenerator::nextAntitheticValues()
+         *
+         * @param out Buffer of at least count * dimension() elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextAntitheticValues(T *out, size_t count);
+
+        /**
+         * @brief Generate a moment-matched batch of count values, see MNVGenerator::nextMomentMatchedValues()
+         *
+         * @param out Buffer of at least count * dimension() elements, values are stored one after another
+         * @param count Amount of values to generate, MUST be greater than dimension()
+         * @return std::optional<MNVGeneratorBuildError> Error if count is too small for the batch covariance
+         *         to be positive-definite, out is unspecified in that case.
+         */
+        std::optional<MNVGeneratorBuildError> nextMomentMatchedValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count values on several threads straight into the caller's buffer.
+         * Works as MNVGenerator::generateParallel(), the output does not depend on threads.
+         *
+         * @param out Buffer of at least count * dimension() elements, values are stored one after another
+         * @param count Amount of values to generate
+         * @param threads Amount of threads to use, the calling one included. 0 means std::thread::hardware_concurrency()
+         */
+        void generateParallel(T *out, size_t count, size_t threads = 0);
+
+        /**
+         * @brief Set a new seed for internal rng, generateParallel() substreams restart from the new seed as well
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng, e.g. to select a stream or discard() values of a counter-based engine
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Rank-1 update of the distribution: covariance becomes covariance + v * v^T.
+         * The Choletsky factor is updated in O(dimension()^2), no rebuild is needed.
+         *
+         * @param v Vector of dimension() elements
+         */
+        void update(T const *v);
+
+        /**
+         * @brief Rank-1 downdate of the distribution: covariance becomes covariance - v * v^T, in O(dimension()^2).
+         *
+         * @param v Vector of dimension() elements
+         * @return std::optional<MNVGeneratorBuildError> Error if the result would not be positive-definite,
+         *         the generator is left unchanged in that case.
+         */
+        std::optional<MNVGeneratorBuildError> downdate(T const *v);
+
+        /**
+         * @brief Exponentially weighted update with a new observation, in O(dimension()^2):
+         * mean = decay * mean + (1 - decay) * value,
+         * covariance = decay * covariance + decay * (1 - decay) * (value - previous mean) * (value - previous mean)^T
+         *
+         * @param value Observation of dimension() elements
+         * @param decay Weight of the distribution so far, within (0, 1]
+         * @return std::optional<MNVGeneratorBuildError> DecayIsOutOfRange if decay is out of range, the generator is left unchanged in that case.
+         */
+        std::optional<MNVGeneratorBuildError> observe(T const *value, T decay);
+
+        /**
+         * @brief Log-density of the distribution at x, see MNVGenerator::logPdf()
+         *
+         * @param x Point of dimension() elements
+         * @return T log N(x | mean, covariance)
+         */
+        T logPdf(T const *x) const;
+
+        /**
+         * @brief Log-density of the distribution at count points, see MNVGenerator::logPdf()
+         *
+         * @param points count * dimension() elements, points are stored one after another
+         * @param count Amount of points
+         * @param out Buffer of at least count elements
+         */
+        void logPdf(T const *points, size_t count, T *out) const;
+
+        /**
+         * @brief Mahalanobis distance of x, see MNVGenerator::mahalanobis()
+         *
+         * @param x Point of dimension() elements
+         * @return T Distance
+         */
+        T mahalanobis(T const *x) const;
+
+        /**
+         * @brief Mahalanobis distances of count points, see MNVGenerator::mahalanobis()
+         *
+         * @param points count * dimension() elements, points are stored one after another
+         * @param count Amount of points
+         * @param out Buffer of at least count elements
+         */
+        void mahalanobis(T const *points, size_t count, T *out) const;
+
+        /**
+         * @brief Dimension count of values
+         *
+         */
+        size_t dimension() const;
+
+        /**
+         * @brief Write a binary snapshot of the generator, see MNVGenerator::save()
+         *
+         * @param out Binary stream
+         */
+        void save(std::ostream &out) const;
+
+        /**
+         * @brief Constructor from a snapshot, the factor and the mean are copied, see MNVGenerator::load()
+         *
+         * @param data Snapshot bytes
+         * @param size Snapshot size in bytes
+         * @return std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError> Generator or SnapshotIsNotValid
+         */
+        static std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        load(void const *data, size_t size);
+
+        /**
+         * @brief Constructor from a snapshot, the factor and the mean are copied, see MNVGenerator::load()
+         *
+         * @param in Binary stream, read to its end
+         * @return std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError> Generator or SnapshotIsNotValid
+         */
+        static std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        load(std::istream &in);
+
+        /**
+         * @brief Constructor from a mapped snapshot file without copies: the generator reads the factor and the mean
+         * straight from the mapping and keeps the file alive. Any number of generators, in any number of processes,
+         * can share one file. The first update(), downdate() or observe() makes a private copy.
+         *
+         * @param file Snapshot file
+         * @return std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError> Generator or SnapshotIsNotValid
+         */
+        static std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        load(std::shared_ptr<SnapshotFile const> file);
+
+        /**
+         * @brief Main constructor fuction, see MNVGenerator::build()
+         *
+         * @param covariance Covariance matrix, dim * dim elements row by row. MUST be positive-definite and symmetric.
+         * @param mean Mean vector, dim elements.
+         * @param dim Dimension count of values.
+         * @param seed Internal rng seed.
+         * @param threads Amount of threads used to factor the covariance matrix, only matters for large dimensions.
+         * @return std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of DynamicMNVGenerator.
+         */
+        static std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        build(
+            T const *covariance,
+            T const *mean,
+            size_t dim,
+            size_t seed = 0,
+            size_t threads = 1);
+
+        /**
+         * @brief Main constructor fuction, see MNVGenerator::build()
+         *
+         * @param covariance Covariance matrix, mean.size() * mean.size() elements row by row. MUST be positive-definite and symmetric.
+         * @param mean Mean vector, its size defines the dimension.
+         * @param seed Internal rng seed.
+         * @param threads Amount of threads used to factor the covariance matrix, only matters for large dimensions.
+         * @return std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of DynamicMNVGenerator.
+         */
+        static std::variant<DynamicMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        build(
+            std::vector<T> const &covariance,
+            std::vector<T> const &mean,
+            size_t seed = 0,
+            size_t threads = 1);
+
+    private:
+        // private constructor is used to force DynamicMNVGenerator::build()
+        DynamicMNVGenerator(std::unique_ptr<T[], internal::AlignedDeleter<T>> storage, size_t dim, size_t seed);
+
+        T const *decomposedCovariance() const;
+        T const *mean() const;
+
+        // copies a mapped snapshot into m_storage before the distribution is modified
+        void makeStorageOwned();
+
+        // distribution params: packed Choletsky factor, padded to a cache line, followed by the mean
+        std::unique_ptr<T[], internal::AlignedDeleter<T>> m_storage{};
+        size_t m_dim{0};
+
+        // used instead of m_storage when the params are read from a mapped snapshot
+        std::shared_ptr<SnapshotFile const> m_snapshot{};
+        T const *m_mappedStorage{nullptr};
+
+        T m_logDeterminant{}; // of the covariance, kept up to date by update(), downdate() and observe()
+
+        // rng params
+        size_t m_seed{0};
+        Engine m_generator{};
+        std::uint64_t m_nextSubstream{0}; // first substream of the next generateParallel() call
+    };
+
+    template <typename T, size_t Dim, typename Engine>
+    class MNVSampler;
+
+    /**
+     * @brief Immutable, reference-counted distribution params: the Choletsky factor and the mean in one cache-aligned block.
+     * Copies share the block, so one distribution can serve any number of MNVSampler handles on any number of threads
+     * without duplicating the factor. Nothing can modify the params after build().
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Dimension count of values
+     */
+    template <typename T, size_t Dim>
+    class MNVDistribution
+    {
+    public:
+        /**
+         * @brief Create a sampling handle in O(1): the params are shared, not copied
+         *
+         * @tparam Engine Uniform random bit generator of the handle, the small mnv::Philox4x32 by default
+         * @param seed Rng seed of the handle, 0 means a random one
+         * @return MNVSampler<T, Dim, Engine> Sampling handle
+         */
+        template <typename Engine = Philox4x32>
+        MNVSampler<T, Dim, Engine> sampler(size_t seed = 0) const;
+
+        /**
+         * @brief Choletsky factor of the covariance matrix, packed lower triangle of Dim * (Dim + 1) / 2 elements, cache-aligned
+         *
+         */
+        T const *decomposedCovariance() const;
+
+        /**
+         * @brief Mean vector of Dim elements, cache-aligned
+         *
+         */
+        T const *mean() const;
+
+        /**
+         * @brief Log-density of the distribution at x. Uses the stored Choletsky factor and the log-determinant
+         * cached at build, so it costs one forward substitution, O(Dim^2).
+         *
+         * @param x Point
+         * @return T log N(x | mean, covariance)
+         */
+        T logPdf(valueVector<T, Dim> const &x) const;
+
+        /**
+         * @brief Log-density of the distribution at count points. The points are solved against the factor in blocks,
+         * with the block of points as the innermost, vectorized loop.
+         *
+         * @param points count * Dim elements, points are stored one after another
+         * @param count Amount of points
+         * @param out Buffer of at least count elements
+         */
+        void logPdf(T const *points, size_t count, T *out) const;
+
+        /**
+         * @brief Mahalanobis distance sqrt((x - mean)^T covariance^-1 (x - mean)) of x, O(Dim^2)
+         *
+         * @param x Point
+         * @return T Distance
+         */
+        T mahalanobis(valueVector<T, Dim> const &x) const;
+
+        /**
+         * @brief Mahalanobis distances of count points, blocked as logPdf(T const *, size_t, T *) const
+         *
+         * @param points count * Dim elements, points are stored one after another
+         * @param count Amount of points
+         * @param out Buffer of at least count elements
+         */
+        void mahalanobis(T const *points, size_t count, T *out) const;
+
+        /**
+         * @brief Main constructor fuction, see MNVGenerator::build()
+         *
+         * @param covariance Covariance matrix. MUST be positive-definite and symmetric.
+         * @param mean Mean vector.
+         * @param threads Amount of threads used to factor the covariance matrix, only matters for large dimensions.
+         * @return std::variant<MNVDistribution<T, Dim>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of MNVDistribution.
+         */
+        static std::variant<MNVDistribution<T, Dim>, MNVGeneratorBuildError>
+        build(
+            MatrixSq<T, Dim> const &covariance,
+            valueVector<T, Dim> const &mean,
+            size_t threads = 1);
+
+        /**
+         * @brief Constructor from a ready factor, see MNVGenerator::build(CovarianceFactor<T, Dim> const &, valueVector<T, Dim> const &, size_t)
+         *
+         * @param factor Choletsky factor of the covariance matrix
+         * @param mean Mean vector.
+         * @return std::variant<MNVDistribution<T, Dim>, MNVGeneratorBuildError> \n
+         *          If the factor is not valid, variant will contain its MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of MNVDistribution.
+         */
+        static std::variant<MNVDistribution<T, Dim>, MNVGeneratorBuildError>
+        build(
+            CovarianceFactor<T, Dim> const &factor,
+            valueVector<T, Dim> const &mean);
+
+    private:
+        // private constructor is used to force MNVDistribution::build()
+        explicit MNVDistribution(std::shared_ptr<T const> storage);
+
+        // packed Choletsky factor, padded to a cache line, followed by the mean
+        std::shared_ptr<T const> m_storage{};
+        T m_logDeterminant{}; // of the covariance
+    };
+
+    /**
+     * @brief Lightweight sampling handle of a shared MNVDistribution: a reference to the params plus the rng state.
+     * Handles are made by MNVDistribution::sampler() in O(1). The same distribution, seed and engine give
+     * bit-identical values to MNVGenerator. A handle is meant for one thread at a time, make one per thread.
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, the small mnv::Philox4x32 by default
+     */
+    template <typename T, size_t Dim, typename Engine = Philox4x32>
+    class MNVSampler
+    {
+    public:
+        /**
+         * @brief Generate the next value of rng.
+         *
+         * @return valueVector<T, Dim> Generated value
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer, see MNVGenerator::nextValues()
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Generate count values on several threads, see MNVGenerator::generateParallel()
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         * @param threads Amount of threads to use, the calling one included. 0 means std::thread::hardware_concurrency()
+         */
+        void generateParallel(T *out, size_t count, size_t threads = 0);
+
+        /**
+         * @brief Set a new seed for internal rng, generateParallel() substreams restart from the new seed as well
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng, e.g. to select a stream or discard() values of a counter-based engine
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief The shared distribution sampled
+         *
+         */
+        MNVDistribution<T, Dim> const &distribution() const;
+
+    private:
+        friend class MNVDistribution<T, Dim>;
+
+        // private constructor is used to force MNVDistribution::sampler()
+        MNVSampler(MNVDistribution<T, Dim> distribution, size_t seed);
+
+        MNVDistribution<T, Dim> m_distribution;
+
+        // rng params
+        size_t m_seed{0};
+        Engine m_generator{};
+        std::uint64_t m_nextSubstream{0}; // first substream of the next generateParallel() call
+    };
+
+    /**
+     * @brief Generator of the conditional distribution of the free components given values of the observed ones.
+     * With the components split into observed (1) and free (2) ones, the free components given x1 are normal with
+     * mean mean2 + A * (x1 - mean1), A = covariance21 * covariance11^-1, and with the Schur complement
+     * covariance22 - covariance21 * covariance11^-1 * covariance12 as covariance.
+     * build() computes A and the Choletsky factor of the Schur complement once per partition, after that every condition()
+     * is one matrix-vector product and values cost as much as from an MNVGenerator of the free components alone.
+     * Values are full Dim vectors, their observed components hold the conditioning values.
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default
+     */
+    template <typename T, size_t Dim, typename Engine = std::mt19937>
+    class ConditionalMNVGenerator
+    {
+    public:
+        /**
+         * @brief Set the values of the observed components, in the order of observedIndices(). Costs O(free * observed).
+         * Until the first call, the observed components are conditioned on their means.
+         *
+         * @param observedValues observedIndices().size() values
+         */
+        void condition(T const *observedValues);
+
+        /**
+         * @brief Set the values of the observed components, taken from a full vector. Its free components are ignored.
+         *
+         * @param point Vector holding the observed values at observedIndices()
+         */
+        void condition(valueVector<T, Dim> const &point);
+
+        /**
+         * @brief Generate the next value of the conditional distribution.
+         *
+         * @return valueVector<T, Dim> Generated value, the observed components hold the conditioning values
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Generate count next values straight into the caller's buffer.
+         * The free components are drawn in one batch, as by MNVGenerator::nextValues().
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Mean of the conditional distribution, the observed components hold the conditioning values
+         *
+         */
+        valueVector<T, Dim> conditionalMean() const;
+
+        /**
+         * @brief Indices of the observed components, in the order condition() takes their values
+         *
+         */
+        std::vector<size_t> const &observedIndices() const;
+
+        /**
+         * @brief Indices of the free components, ascending
+         *
+         */
+        std::vector<size_t> const &freeIndices() const;
+
+        /**
+         * @brief Set a new seed for internal rng
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
+         *
+         * @param covariance Covariance matrix of all Dim components. MUST be positive-definite and symmetric.
+         * @param mean Mean vector of all Dim components.
+         * @param observedIndices Distinct indices of the observed components, less than Dim of them.
+         * @param seed Internal rng seed.
+         * @return std::variant<ConditionalMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If an index is out of range or repeated, or no component is left free, variant will contain DimensionsDoNotMatch. \n
+         *          If the covariance matrix is not symmetric or not positive-definite, the corresponding error. \n
+         *          Else, there will be an instance of ConditionalMNVGenerator.
+         */
+        static std::variant<ConditionalMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        build(
+            MatrixSq<T, Dim> const &covariance,
+            valueVector<T, Dim> const &mean,
+            std::vector<size_t> observedIndices,
+            size_t seed = 0);
+
+    private:
+        // private constructor is used to force ConditionalMNVGenerator::build()
+        ConditionalMNVGenerator() = default;
+
+        // conditional mean from the deviations of the observed values in m_deviation
+        void updateConditionalMean();
+
+        // partition
+        std::vector<size_t> m_observed{};
+        std::vector<size_t> m_free{};
+
+        // precomputed once per partition
+        std::vector<T> m_regression{};  // A, free rows by observed columns
+        std::vector<T> m_schurFactor{}; // Choletsky factor of the Schur complement, packed
+        valueVector<T, Dim> m_mean{};
+
+        // conditional mean of the free components and the full vector template with the observed values
+        std::vector<T> m_conditionalMean{};
+        valueVector<T, Dim> m_template{};
+        std::vector<T> m_deviation{}; // observed values minus their means, one per observed component
+        std::vector<T> m_buffer{};    // free components of a batch
+
+        // rng params
+        Engine m_generator{};
+    };
+
+    /**
+     * @brief Generator of the distribution truncated to a box: values x ~ N(mean, covariance) restricted to
+     * lowerBounds <= x <= upperBounds, componentwise. Bounds may be infinite, e.g. zero lower bounds and infinite upper
+     * ones give the non-negative orthant.
+     * Values come from a Gibbs sampler on the whitened coordinates z of x = mean + L * z, L being the Choletsky factor.
+     * Given the other coordinates, each z_j is a standard normal truncated to an interval, drawn by rejection that
+     * accepts about half of the proposals however far in the tail it is. So the cost of a value stays O(Dim^2) per sweep
+     * even where naive rejection from the full distribution would almost never accept.
+     * Successive values form a Markov chain and are correlated; more sweeps per value make them less so.
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default
+     */
+    template <typename T, size_t Dim, typename Engine = std::mt19937>
+    class TruncatedMNVGenerator
+    {
+    public:
+        /**
+         * @brief Generate the next value of the truncated distribution.
+         *
+         * @return valueVector<T, Dim> Generated value, within the bounds
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Generate count next values straight into the caller's buffer.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Lower bounds of the components, -infinity where unbounded
+         *
+         */
+        valueVector<T, Dim> const &lowerBounds() const;
+
+        /**
+         * @brief Upper bounds of the components, infinity where unbounded
+         *
+         */
+        valueVector<T, Dim> const &upperBounds() const;
+
+        /**
+         * @brief Set a new seed for internal rng. The state of the chain is kept.
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
+         *
+         * @param covariance Covariance matrix. MUST be positive-definite and symmetric.
+         * @param mean Mean vector of the untruncated distribution.
+         * @param lowerBounds Lower bound of every component, -std::numeric_limits<T>::infinity() for none.
+         * @param upperBounds Upper bound of every component, std::numeric_limits<T>::infinity() for none.
+         * @param seed Internal rng seed.
+         * @param sweepsPerValue Gibbs sweeps between successive values, 0 is taken as 1.
+         * @param burnIn Gibbs sweeps made by build() from the starting point, which is feasible but not a draw.
+         * @return std::variant<TruncatedMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If a lower bound is not less than its upper bound, or either is NaN, variant will contain BoundsAreNotValid. \n
+         *          If the covariance matrix is not symmetric or not positive-definite, the corresponding error. \n
+         *          Else, there will be an instance of TruncatedMNVGenerator.
+         */
+        static std::variant<TruncatedMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        build(
+            MatrixSq<T, Dim> const &covariance,
+            valueVector<T, Dim> const &mean,
+            valueVector<T, Dim> const &lowerBounds,
+            valueVector<T, Dim> const &upperBounds,
+            size_t seed = 0,
+            size_t sweepsPerValue = 1,
+            size_t burnIn = 64);
+
+    private:
+        // private constructor is used to force TruncatedMNVGenerator::build()
+        TruncatedMNVGenerator() = default;
+
+        // distribution params, the Choletsky factor is stored packed
+        MatrixLowerTriangular<T, Dim> m_decomposedCovariance{};
+        valueVector<T, Dim> m_mean{};
+        valueVector<T, Dim> m_lowerBounds{};
+        valueVector<T, Dim> m_upperBounds{};
+
+        // chain state: the whitened coordinates and L * z, in double whatever T is
+        std::vector<double> m_whitened{};
+        std::vector<double> m_shifted{};
+        size_t m_sweepsPerValue{1};
+
+        // rng params
+        Engine m_generator{};
+    };
+
+    /**
+     * @brief Generator of a Gaussian mixture: every value comes from one of the components, picked with probability
+     * proportional to its weight, each component being N(means[c], covariances[c]).
+     * All factors and means are stored contiguously and share one engine. Components are picked with a Walker alias
+     * table, and every value costs the same whatever the component count. Batches large enough to put several values
+     * on a component on average are grouped: the components of the batch are drawn first, then the values of every
+     * component drawn are transformed together, so its factor is applied once per batch as a blocked matrix-matrix
+     * product. Smaller batches, nextValue() included, transform value by value. Therefore, unlike MNVGenerator,
+     * the sequence depends on how values are split into batches.
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default
+     */
+    template <typename T, size_t Dim, typename Engine = std::mt19937>
+    class MixtureMNVGenerator
+    {
+    public:
+        /**
+         * @brief Generate the next value of the mixture.
+         *
+         * @return valueVector<T, Dim> Generated value
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Generate count next values straight into the caller's buffer.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Amount of components values are drawn from, the ones of zero weight are not counted
+         *
+         */
+        size_t componentCount() const;
+
+        /**
+         * @brief Set a new seed for internal rng
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
+         *
+         * @param weights Weight of every component, non-negative and finite. They do not have to sum to 1, zero weights drop their components.
+         * @param covariances Covariance matrix of every component. MUST be positive-definite and symmetric.
+         * @param means Mean vector of every component.
+         * @param seed Internal rng seed.
+         * @return std::variant<MixtureMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If there are no components or the sizes of weights, covariances and means differ, variant will contain DimensionsDoNotMatch. \n
+         *          If a weight is negative or not finite, or none is positive, variant will contain WeightsAreNotValid. \n
+         *          If a covariance matrix is not symmetric or not positive-definite, the corresponding error. \n
+         *          Else, there will be an instance of MixtureMNVGenerator.
+         */
+        static std::variant<MixtureMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        build(
+            std::vector<T> const &weights,
+            std::vector<MatrixSq<T, Dim>> const &covariances,
+            std::vector<valueVector<T, Dim>> const &means,
+            size_t seed = 0);
+
+    private:
+        // private constructor is used to force MixtureMNVGenerator::build()
+        MixtureMNVGenerator() = default;
+
+        size_t nextComponent();
+
+        // components, one after another
+        std::vector<T> m_factors{}; // packed
+        std::vector<T> m_means{};
+
+        // alias table: column c is kept with probability m_keep[c], else replaced by m_alias[c]
+        std::vector<double> m_keep{};
+        std::vector<size_t> m_alias{};
+
+        // batch scratch: components drawn, the distinct ones in order of appearance and the group of every component
+        // (noGroup unless drawn in the current batch), values grouped by component, where each group starts and
+        // the next free place of each group
+        static constexpr size_t noGroup = static_cast<size_t>(-1);
+        std::vector<size_t> m_drawn{};
+        std::vector<size_t> m_distinct{};
+        std::vector<size_t> m_groupOf{};
+        std::vector<size_t> m_order{};
+        std::vector<size_t> m_groupStart{};
+        std::vector<size_t> m_groupNext{};
+        std::vector<T> m_buffer{};
+
+        // rng params
+        Engine m_generator{};
+    };
+
+    /**
+     * @brief Generator for factor-model covariances: covariance = loadings * loadings^T + diag(idiosyncraticVariances).
+     * Values are drawn as mean + loadings * z1 + sqrt(idiosyncraticVariances) * z2, with Factors + Dim standard normals
+     * per value, so neither the full covariance matrix nor its Choletsky factor is ever formed.
+     * Build, memory and every value cost O(Dim * Factors) instead of O(Dim^3) and O(Dim^2).
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     * @tparam Factors Amount of common factors, supposedly much less than Dim
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default
+     */
+    template <typename T, size_t Dim, size_t Factors, typename Engine = std::mt19937>
+    class FactorMNVGenerator
+    {
+    public:
+        /**
+         * @brief Generate the next value of rng.
+         *
+         * @return valueVector<T, Dim> Generated value
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * The result is bit-identical to count consecutive nextValue() calls.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Set a new seed for internal rng
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng, e.g. to select a stream or discard() values of a counter-based engine
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Dense covariance matrix of the model, O(Dim^2 * Factors). Meant for diagnostics only.
+         *
+         * @return MatrixSq<T, Dim> loadings * loadings^T + diag(idiosyncraticVariances)
+         */
+        MatrixSq<T, Dim> covariance() const;
+
+        /**
+         * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
+         *
+         * @param loadings Factor loadings, row i holds the exposures of the i-th component to the factors
+         * @param idiosyncraticVariances Variances of the components not explained by the factors. MUST be positive.
+         * @param mean Mean vector.
+         * @param seed Internal rng seed.
+         * @return std::variant<FactorMNVGenerator<T, Dim, Factors, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of FactorMNVGenerator.
+         */
+        static std::variant<FactorMNVGenerator<T, Dim, Factors, Engine>, MNVGeneratorBuildError>
+        build(
+            MatrixRect<T, Dim, Factors> const &loadings,
+            valueVector<T, Dim> const &idiosyncraticVariances,
+            valueVector<T, Dim> const &mean,
+            size_t seed = 0);
+
+    private:
+        // private constructor is used to force FactorMNVGenerator::build()
+        FactorMNVGenerator(MatrixRect<T, Dim, Factors> const &loadings, valueVector<T, Dim> const &idiosyncraticDeviations,
+                           valueVector<T, Dim> const &mean, size_t seed);
+
+        // distribution params
+        MatrixRect<T, Dim, Factors> m_loadings{};
+        valueVector<T, Dim> m_idiosyncraticDeviations{}; // square roots of the idiosyncratic variances
+        valueVector<T, Dim> m_mean{};
+
+        // normals of one value: common factors first, then the idiosyncratic part
+        valueVector<T, Factors + Dim> m_normals{};
+
+        // rng params
+        size_t m_seed{0};
+        Engine m_generator{};
+    };
+
+    /**
+     * @brief Quasi-Monte Carlo generator: the points of an Owen-scrambled Sobol sequence are mapped through
+     * the inverse normal CDF and the Choletsky transform of MNVGenerator. Estimates of expectations converge
+     * close to O(1/N) for smooth integrands instead of O(1/sqrt(N)), so far fewer values give the same accuracy. \n
+     * Values are not independent, they fill the space evenly; use counts that are powers of two for the best balance.
+     * Every point of the sequence can be addressed directly (valuesAt()), so parallel chunks need no state.
+     * The sequence has 2^32 points, the seed selects the scrambling.
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     */
+    template <typename T, size_t Dim>
+    class QuasiMNVGenerator
+    {
+    public:
+        /**
+         * @brief Generate the next value of the sequence.
+         *
+         * @return valueVector<T, Dim> Generated value
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Generate count next values of the sequence straight into the caller's buffer.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Generate count next values of the sequence straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to generate
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Skip-ahead: values first ... first + count - 1 of the sequence, the position is not changed.
+         * Safe to call from several threads at once.
+         *
+         * @param first Index of the first value
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void valuesAt(std::uint64_t first, T *out, size_t count) const;
+
+        /**
+         * @brief Generate count next values of the sequence on several threads, the same values as nextValues().
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to generate
+         * @param threads Amount of threads to use, the calling one included. 0 means std::thread::hardware_concurrency()
+         */
+        void generateParallel(T *out, size_t count, size_t threads = 0);
+
+        /**
+         * @brief Move the position in the sequence forward
+         *
+         * @param count Amount of values to skip
+         */
+        void discard(std::uint64_t count);
+
+        /**
+         * @brief Index of the next value of the sequence
+         *
+         */
+        std::uint64_t position() const;
+
+        /**
+         * @brief Select another scrambling, the sequence restarts from its first value
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
+         *
+         * @param covariance Covariance matrix. MUST be positive-definite and symmetric.
+         * @param mean Mean vector.
+         * @param seed Scrambling seed.
+         * @param threads Amount of threads used to factor the covariance matrix, only matters for large dimensions.
+         * @return std::variant<QuasiMNVGenerator<T, Dim>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of QuasiMNVGenerator.
+         */
+        static std::variant<QuasiMNVGenerator<T, Dim>, MNVGeneratorBuildError>
+        build(
+            MatrixSq<T, Dim> const &covariance,
+            valueVector<T, Dim> const &mean,
+            size_t seed = 0,
+            size_t threads = 1);
+
+    private:
+        // private constructor is used to force QuasiMNVGenerator::build()
+        QuasiMNVGenerator(MatrixLowerTriangular<T, Dim> const &decomposedCovariance, valueVector<T, Dim> const &mean, size_t seed);
+
+        // distribution params, the Choletsky factor is stored packed
+        MatrixLowerTriangular<T, Dim> m_decomposedCovariance{};
+        valueVector<T, Dim> m_mean{};
+
+        // sequence params
+        std::vector<std::uint32_t> m_directions{}; // Sobol direction numbers, 32 per dimension
+        std::vector<std::uint32_t> m_scrambles{};  // Owen scrambling seed of every dimension
+        std::uint64_t m_position{0};
+
+        // point of index m_position, so nextValues() continues without a rebuild, and its scratch buffers
+        std::vector<std::uint32_t> m_point{};
+        std::vector<double> m_uniforms{};
+        std::vector<double> m_normals{};
+    };
+
+    /**
+     * @brief Wrapper around MNVGenerator that draws values ahead of time on its own producer thread.
+     * Values are kept in a preallocated cache-aligned ring of capacity values. The producer sleeps while the ring
+     * holds more than lowWatermark values and then refills it up to highWatermark, so the consumer's nextValue()
+     * is a copy out of the ring and an index bump, without locks. The consumer blocks only if the ring runs empty.
+     * The values come in the same order as from the wrapped generator's nextValue(), so a given seed gives the same sequence.
+     * The consumer side is meant for a single thread. Copying is disabled, moving keeps the producer running.
+     *
+     * @tparam T Type of values generated
+     * @tparam Dim Dimension count of values
+     * @tparam Engine Uniform random bit generator of the wrapped MNVGenerator
+     */
+    template <typename T, size_t Dim, typename Engine = std::mt19937>
+    class BufferedMNVGenerator
+    {
+    public:
+        /**
+         * @brief Take the next value out of the ring, waits for the producer if the ring is empty.
+         *
+         * @return valueVector<T, Dim> Generated value
+         */
+        valueVector<T, Dim> nextValue();
+
+        /**
+         * @brief Take count next values out of the ring straight into the caller's buffer.
+         *
+         * @param out Buffer of at least count * Dim elements, values are stored one after another
+         * @param count Amount of values to take
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Take count next values out of the ring straight into the caller's buffer.
+         * Same as nextValues(T *, size_t), but takes a range of vectors.
+         *
+         * @param out Pointer to the first of count vectors to be filled
+         * @param count Amount of values to take
+         */
+        void nextValues(valueVector<T, Dim> *out, size_t count);
+
+        /**
+         * @brief Amount of values ready in the ring at the moment
+         *
+         */
+        size_t available() const;
+
+        /**
+         * @brief Amount of values the ring can hold
+         *
+         */
+        size_t capacity() const;
+
+        /**
+         * @brief Main constructor fuction, builds the wrapped MNVGenerator and starts the producer
+         *
+         * @param covariance Covariance matrix. MUST be positive-definite and symmetric.
+         * @param mean Mean vector.
+         * @param seed Internal rng seed.
+         * @param capacity Ring size in values, rounded up to a power of two.
+         * @param lowWatermark The producer wakes up once the ring holds this many values or less, kept below highWatermark.
+         * @param highWatermark The producer fills the ring up to this many values, at most capacity.
+         * @return std::variant<BufferedMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of BufferedMNVGenerator.
+         */
+        static std::variant<BufferedMNVGenerator<T, Dim, Engine>, MNVGeneratorBuildError>
+        build(
+            MatrixSq<T, Dim> const &covariance,
+            valueVector<T, Dim> const &mean,
+            size_t seed = 0,
+            size_t capacity = 4096,
+            size_t lowWatermark = 1024,
+            size_t highWatermark = 4096);
+
+        /**
+         * @brief Constructor from a ready generator, its sequence continues from the current state
+         *
+         * @param generator Generator to be moved to the producer thread.
+         * @param capacity Ring size in values, rounded up to a power of two.
+         * @param lowWatermark The producer wakes up once the ring holds this many values or less, kept below highWatermark.
+         * @param highWatermark The producer fills the ring up to this many values, at most capacity.
+         * @return BufferedMNVGenerator<T, Dim, Engine> Running generator
+         */
+        static BufferedMNVGenerator<T, Dim, Engine>
+        build(
+            MNVGenerator<T, Dim, Engine> generator,
+            size_t capacity = 4096,
+            size_t lowWatermark = 1024,
+            size_t highWatermark = 4096);
+
+    private:
+        struct State;
+
+        // private constructor is used to force BufferedMNVGenerator::build()
+        explicit BufferedMNVGenerator(std::unique_ptr<State> state);
+
+        // ring, indices and producer thread, heap-allocated so that the producer's view survives moves
+        std::unique_ptr<State> m_state{};
+    };
+
+    /**
+     * @brief Square sparse matrix in compressed sparse row (CSR) form.
+     * Columns of row i are columns[rowOffsets[i]] ... columns[rowOffsets[i + 1] - 1], with the matching values.
+     * For a symmetric matrix CSR and CSC forms are the same thing. Both triangles must be present.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     */
+    template <typename T>
+    struct SparseMatrix
+    {
+        size_t dim{0};
+        std::vector<size_t> rowOffsets{}; // dim + 1 elements, rowOffsets[0] == 0
+        std::vector<size_t> columns{};
+        std::vector<T> values{};
+    };
+
+    /**
+     * @brief Symmetric permutation applied to a sparse matrix before its Choletsky decomposition
+     *
+     */
+    enum class SparseOrdering
+    {
+        Natural,            // keep the order as is, best for matrices already banded
+        ReverseCuthillMcKee // reduce the bandwidth, hence the fill of the factor
+    };
+
+    /**
+     * @brief Generator for sparse or banded covariance matrices of a dimension chosen at runtime.
+     * The matrix is reordered to reduce fill, the structure of the factor is found by a symbolic analysis
+     * (elimination tree) and only its nonzeros are stored. Every value costs O(nnz(L)) instead of O(dimension()^2),
+     * which makes dimensions of 10^5 and more feasible for banded and similarly local matrices.
+     * Values are returned in the original order, the permutation is internal. \n
+     * Gaussian Markov random fields can be given by their sparse precision matrix instead (buildFromPrecision()),
+     * then values are drawn by back-substitution with the factor of the precision matrix and no inverse is ever formed.
+     *
+     * @tparam T Type of values generated
+     * @tparam Engine Uniform random bit generator producing 32-bit or 64-bit words, std::mt19937 by default
+     */
+    template <typename T, typename Engine = std::mt19937>
+    class SparseMNVGenerator
+    {
+    public:
+        /**
+         * @brief Generate the next value of rng.
+         *
+         * @return std::vector<T> Generated value of dimension() elements
+         */
+        std::vector<T> nextValue();
+
+        /**
+         * @brief Generate the next value of rng straight into the caller's buffer.
+         *
+         * @param out Buffer of at least dimension() elements
+         */
+        void nextValue(T *out);
+
+        /**
+         * @brief Generate count next values of rng straight into the caller's buffer.
+         * The result is bit-identical to count consecutive nextValue() calls.
+         *
+         * @param out Buffer of at least count * dimension() elements, values are stored one after another
+         * @param count Amount of values to generate
+         */
+        void nextValues(T *out, size_t count);
+
+        /**
+         * @brief Set a new seed for internal rng
+         *
+         * @param seed A new seed
+         */
+        void seed(size_t seed);
+
+        /**
+         * @brief Access the internal rng, e.g. to select a stream or discard() values of a counter-based engine
+         *
+         * @return Engine& The internal rng
+         */
+        Engine &engine();
+
+        /**
+         * @brief Dimension count of values
+         *
+         */
+        size_t dimension() const;
+
+        /**
+         * @brief Amount of nonzeros of the Choletsky factor, i.e. the multiply-adds spent on every value
+         *
+         */
+        size_t factorNonZeros() const;
+
+        /**
+         * @brief Main constructor fuction, construction is implemented as static function to be able to return std::variant instead of throwing errors
+         *
+         * @param covariance Sparse covariance matrix. MUST be positive-definite and symmetric, both triangles stored.
+         * @param mean Mean vector of covariance.dim elements.
+         * @param seed Internal rng seed.
+         * @param ordering Fill-reducing ordering to use.
+         * @return std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of SparseMNVGenerator.
+         */
+        static std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        build(
+            SparseMatrix<T> const &covariance,
+            std::vector<T> const &mean,
+            size_t seed = 0,
+            SparseOrdering ordering = SparseOrdering::ReverseCuthillMcKee);
+
+        /**
+         * @brief Constructor for banded covariance matrices, the band is kept as is since it can not be narrowed
+         *
+         * @param lowerBands Lower half of the band, row by row. Row i holds bandwidth + 1 elements:
+         *        covariance[i][i - bandwidth] ... covariance[i][i], elements left of the matrix are ignored.
+         * @param bandwidth Amount of nonzero diagonals below the main one
+         * @param mean Mean vector.
+         * @param seed Internal rng seed.
+         * @return std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of SparseMNVGenerator.
+         */
+        static std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        build(
+            std::vector<T> const &lowerBands,
+            size_t bandwidth,
+            std::vector<T> const &mean,
+            size_t seed = 0);
+
+        /**
+         * @brief Constructor for distributions given by the precision matrix, the inverse of the covariance matrix.
+         * The precision matrix is factored as L * L^T and values are drawn as mean + L^-T * z,
+         * so its sparsity is kept and every value still costs O(nnz(L)).
+         *
+         * @param precision Sparse precision matrix. MUST be positive-definite and symmetric, both triangles stored.
+         * @param mean Mean vector of precision.dim elements.
+         * @param seed Internal rng seed.
+         * @param ordering Fill-reducing ordering to use.
+         * @return std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError> \n
+         *          If error happened, variant will contain MNVGeneratorBuildError. \n
+         *          Else, there will be an instance of SparseMNVGenerator.
+         */
+        static std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        buildFromPrecision(
+            SparseMatrix<T> const &precision,
+            std::vector<T> const &mean,
+            size_t seed = 0,
+            SparseOrdering ordering = SparseOrdering::ReverseCuthillMcKee);
+
+    private:
+        // private constructor is used to force SparseMNVGenerator::build()
+        SparseMNVGenerator(size_t seed);
+
+        // shared by build() and buildFromPrecision(), matrix is either the covariance or the precision matrix
+        static std::variant<SparseMNVGenerator<T, Engine>, MNVGeneratorBuildError>
+        buildFactor(SparseMatrix<T> const &matrix, std::vector<T> const &mean, size_t seed, SparseOrdering ordering, bool isPrecision);
+
+        // distribution params: permutation and the factor of the permuted matrix, rows stored as CSR
+        bool m_isPrecision{false}; // the factor is the one of the precision matrix, values are drawn by back-substitution
+        size_t m_dim{0};
+        std::vector<size_t> m_permutation{}; // row i of the factor is component m_permutation[i] of values
+        std::vector<size_t> m_factorRowOffsets{};
+        std::vector<size_t> m_factorColumns{};
+        std::vector<T> m_factorValues{};
+        std::vector<T> m_mean{};
+
+        // scratch of nextValues(), grown on demand
+        std::vector<T> m_normals{};
+        std::vector<T> m_block{}; // batch of values, component-major
+
+        // rng params
+        size_t m_seed{0};
+        Engine m_generator{};
+    };
+
+    /**
+     * @brief Function to statistically calculate covariance matrix using statistic data.
+     * Only the lower triangle is accumulated, from centered samples processed in cache-sized blocks,
+     * and mirrored at the end. For a fixed thread count the result is reproducible.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Matrix size
+     * @param input_vectors Input vectors to calculate covariance matrix
+     * @param threads Amount of threads to split the samples between, 0 means std::thread::hardware_concurrency()
+     * @return MatrixSq<T, Dim> The covariance matrix
+     */
+    template <typename T, size_t Dim>
+    MatrixSq<T, Dim> calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &inputVectors, size_t threads = 1);
+
+    /**
+     * @brief Same as calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &, size_t),
+     * but writes into the caller's matrix, e.g. a heap-allocated one for large Dim.
+     *
+     * @tparam T Underlying type, supposedly float/decimal
+     * @tparam Dim Matrix size
+     * @param input_vectors Input vectors to calculate covariance matrix
+     * @param result The covariance matrix, every element is overwritten
+     * @param threads Amount of threads to split the samples between, 0 means std::thread::hardware_concurrency()
      */
     template <typename T, size_t Dim>
-    MatrixSq<T, Dim> calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &inputVectors);
+    void calculateCovarianceMatrix(std::vector<valueVector<T, Dim>> const &inputVectors, MatrixSq<T, Dim> &result, size_t threads = 1);
 
     /**
      * @brief Function to statistically calculate mean vector using statistic data
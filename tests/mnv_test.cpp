@@ -1,9 +1,24 @@
 #include <mnv/mnv.hpp>
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -81,6 +96,80 @@ TEST(linearAlgebraTest, choletskyDecompositionWorks)
     }
 }
 
+TEST(linearAlgebraTest, tryCholetskyDecompositionDetectsDefiniteness)
+{
+    const mnv::MatrixSq<double, 3> negDef{{{-2, 1, 0},
+                                           {1, -2, 0},
+                                           {0, 0, -2}}};
+    const mnv::MatrixSq<double, 3> singular{{{1, 2, 3},
+                                             {2, 4, 6},
+                                             {3, 6, 9}}};
+    mnv::MatrixSq<double, 3> result{};
+    EXPECT_FALSE(mnv::internal::tryCholetskyDecomposition(negDef, result));
+    EXPECT_FALSE(mnv::internal::tryCholetskyDecomposition(singular, result));
+
+    mnv::MatrixSq<double, 6> decomposed{};
+    EXPECT_TRUE(mnv::internal::tryCholetskyDecomposition(testMatrix, decomposed));
+    for (size_t i = 0; i < decomposed.size(); i++)
+    {
+        for (size_t j = 0; j < decomposed.size(); j++)
+        {
+            EXPECT_NEAR(decomposed[i][j], testMatrixDecomposed[i][j], 0.001) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+}
+
+TEST(linearAlgebraTest, blockedCholetskyDecompositionWorks)
+{
+    // spans several blocks and a partial one, the first trailing updates are large enough to run on several threads
+    const size_t dim = mnv::internal::choletskyParallelThreshold + mnv::internal::choletskyBlockSize + 37;
+    std::vector<double> matrix(dim * dim);
+    std::mt19937 engine{5};
+    std::uniform_real_distribution<double> uniform{-1, 1};
+    std::vector<double> factor(dim * dim);
+    for (auto &value : factor)
+    {
+        value = uniform(engine);
+    }
+    // A = B * B^T + dim * I
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            double sum = i == j ? static_cast<double>(dim) : 0.0;
+            for (size_t k = 0; k < dim; k++)
+            {
+                sum += factor[i * dim + k] * factor[j * dim + k];
+            }
+            matrix[i * dim + j] = sum;
+        }
+    }
+
+    std::vector<double> single(mnv::internal::packedRowOffset(dim));
+    std::vector<double> parallel(mnv::internal::packedRowOffset(dim));
+    ASSERT_TRUE(mnv::internal::tryCholetskyDecomposition(matrix.data(), dim, single.data(), 1));
+    ASSERT_TRUE(mnv::internal::tryCholetskyDecomposition(matrix.data(), dim, parallel.data(), 4));
+    EXPECT_EQ(single, parallel);
+
+    // L * L^T restores the matrix
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j <= i; j++)
+        {
+            double sum = 0;
+            for (size_t k = 0; k <= j; k++)
+            {
+                sum += single[mnv::internal::packedRowOffset(i) + k] * single[mnv::internal::packedRowOffset(j) + k];
+            }
+            ASSERT_NEAR(sum, matrix[i * dim + j], 1e-9 * static_cast<double>(dim)) << "i and j were " << i << " " << j;
+        }
+    }
+
+    // a broken pivot in a later block is detected
+    matrix[(dim - 3) * dim + dim - 3] = -1;
+    EXPECT_FALSE(mnv::internal::tryCholetskyDecomposition(matrix.data(), dim, single.data(), 4));
+}
+
 TEST(linearAlgebraTest, minorCalculationWorks)
 {
     const std::array<double, 6> testingMatrixMinors =
@@ -127,6 +216,171 @@ TEST(linearAlgebraTest, multiplyMatrixByVectorWorks)
     ASSERT_THAT(result, testing::ElementsAre(2, -2, -24));
 }
 
+TEST(linearAlgebraTest, packedLowerTriangularWorks)
+{
+    const mnv::MatrixSq<double, 3> matrix{{{1, 0, 0},
+                                           {2, 3, 0},
+                                           {4, 5, 6}}};
+    const mnv::MatrixLowerTriangular<double, 3> packed = mnv::internal::packLowerTriangular(matrix);
+    ASSERT_THAT(packed, testing::ElementsAre(1, 2, 3, 4, 5, 6));
+    EXPECT_EQ((mnv::internal::unpackLowerTriangular<double, 3>(packed)), matrix);
+
+    const mnv::valueVector<double, 3> vector{{1, 2, 3}};
+    ASSERT_THAT(mnv::internal::multiplyLowerTriangularByVector(packed, vector), testing::ElementsAre(1, 8, 32));
+    EXPECT_EQ(mnv::internal::multiplyLowerTriangularByVector(packed, vector),
+              mnv::internal::multiplyMatrixByVector(matrix, vector));
+}
+
+TEST(standardNormalTest, portableExpAndLogWork)
+{
+    for (double x : {-700.0, -30.5, -3.0, -0.5, -1e-9, 0.0, 0.25, 1.0, 7.5})
+    {
+        EXPECT_NEAR(mnv::internal::portableExp(x), std::exp(x), 4 * std::numeric_limits<double>::epsilon() * std::exp(x)) << x;
+    }
+    for (double x : {1e-300, 1e-9, 0.3, 0.7071, 1.0, 1.5, 2.0, 1e10})
+    {
+        EXPECT_NEAR(mnv::internal::portableLog(x), std::log(x), 4 * std::numeric_limits<double>::epsilon() * std::max(1.0, std::abs(std::log(x)))) << x;
+    }
+}
+
+TEST(standardNormalTest, fastPathKernelsAgree)
+{
+    std::mt19937_64 engine{42};
+    const auto &tables = mnv::internal::zigguratTables();
+
+    for (size_t count : {size_t{1}, size_t{3}, size_t{4}, size_t{17}, size_t{64}})
+    {
+        std::array<std::uint64_t, 64> bits{};
+        for (size_t i = 0; i < count; i++)
+        {
+            bits[i] = engine();
+        }
+
+        std::array<double, 64> scalar{};
+        std::array<double, 64> dispatched{};
+        const auto scalarRejected = mnv::internal::zigguratFastPathScalar(tables, bits.data(), scalar.data(), count);
+        const auto dispatchedRejected = mnv::internal::zigguratFastPath(tables, bits.data(), dispatched.data(), count);
+
+        EXPECT_EQ(scalarRejected, dispatchedRejected);
+        for (size_t i = 0; i < count; i++)
+        {
+            EXPECT_EQ(std::memcmp(&scalar[i], &dispatched[i], sizeof(double)), 0) << "lane " << i;
+        }
+    }
+}
+
+TEST(standardNormalTest, fillStandardNormalIsReproducible)
+{
+    // std::mt19937 is fully specified by the standard and the sampler is portable,
+    // so these values must not change between compilers and standard libraries
+    std::mt19937 engine{42};
+    std::array<double, 6> values{};
+    mnv::internal::fillStandardNormal(engine, values.data(), values.size());
+
+    std::mt19937 sameEngine{42};
+    std::array<double, 6> sameValues{};
+    mnv::internal::fillStandardNormal(sameEngine, sameValues.data(), sameValues.size());
+    EXPECT_EQ(values, sameValues);
+
+    const std::array<double, 6> expected{-0x1.48f349ef0e078p-1, 0x1.2b3dcf360fa57p+1, 0x1.0d979664ff99bp+0,
+                                         0x1.5e147bbcca00cp+0, 0x1.7aef3218d3688p-4, -0x1.8ac2e6211f01ap-3};
+    EXPECT_EQ(values, expected);
+}
+
+TEST(standardNormalTest, fillStandardNormalIsStandardNormal)
+{
+    std::mt19937 engine{1};
+    std::vector<double> values(1000000);
+    mnv::internal::fillStandardNormal(engine, values.data(), values.size());
+
+    double sum = 0;
+    double sumOfSquares = 0;
+    double sumOfFourthPowers = 0;
+    size_t belowOne = 0;
+    size_t beyondTail = 0;
+    for (double value : values)
+    {
+        sum += value;
+        sumOfSquares += value * value;
+        sumOfFourthPowers += value * value * value * value;
+        belowOne += value < 1.0;
+        beyondTail += std::abs(value) > 3.5;
+    }
+
+    const double n = static_cast<double>(values.size());
+    EXPECT_NEAR(sum / n, 0.0, 0.005);
+    EXPECT_NEAR(sumOfSquares / n, 1.0, 0.005);
+    EXPECT_NEAR(sumOfFourthPowers / n, 3.0, 0.05);
+    EXPECT_NEAR(static_cast<double>(belowOne) / n, 0.8413447, 0.002);
+    // 2 * (1 - Phi(3.5)) = 4.65e-4
+    EXPECT_NEAR(static_cast<double>(beyondTail) / n, 4.65e-4, 1e-4);
+}
+
+TEST(philoxTest, knownAnswersMatch)
+{
+    // known answer vectors of the Random123 reference implementation
+    EXPECT_THAT(mnv::internal::philox4x32({0, 0, 0, 0}, {0, 0}),
+                testing::ElementsAre(0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u));
+    EXPECT_THAT(mnv::internal::philox4x32({0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}, {0xffffffffu, 0xffffffffu}),
+                testing::ElementsAre(0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu));
+    EXPECT_THAT(mnv::internal::philox4x32({0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}, {0xa4093822u, 0x299f31d0u}),
+                testing::ElementsAre(0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u));
+
+    mnv::Philox4x32 engine{0};
+    EXPECT_EQ(engine(), 0x6627e8d5u);
+    EXPECT_EQ(engine(), 0xe169c58du);
+}
+
+TEST(philoxTest, discardMatchesGeneration)
+{
+    for (unsigned long long skip : {0ull, 1ull, 3ull, 4ull, 5ull, 8ull, 1001ull})
+    {
+        for (unsigned long long consumed : {0ull, 1ull, 3ull, 4ull})
+        {
+            mnv::Philox4x32 generated{123, 7};
+            mnv::Philox4x32 discarded{123, 7};
+            for (unsigned long long i = 0; i < consumed; i++)
+            {
+                generated();
+                discarded();
+            }
+
+            for (unsigned long long i = 0; i < skip; i++)
+            {
+                generated();
+            }
+            discarded.discard(skip);
+
+            EXPECT_EQ(generated, discarded) << "skip " << skip << " consumed " << consumed;
+            for (size_t i = 0; i < 9; i++)
+            {
+                EXPECT_EQ(generated(), discarded());
+            }
+        }
+    }
+}
+
+TEST(philoxTest, streamsAndSeedsDiffer)
+{
+    mnv::Philox4x32 first{1, 0};
+    mnv::Philox4x32 otherStream{1, 1};
+    mnv::Philox4x32 otherSeed{2, 0};
+    mnv::Philox4x32 same{1, 0};
+
+    EXPECT_NE(first, otherStream);
+    EXPECT_NE(first, otherSeed);
+    EXPECT_EQ(first, same);
+
+    const auto value = first();
+    EXPECT_NE(value, otherStream());
+    EXPECT_NE(value, otherSeed());
+    EXPECT_EQ(value, same());
+
+    otherStream.stream(0);
+    otherStream();
+    EXPECT_EQ(first, otherStream);
+}
+
 TEST(statisticCalculationsTest, calculateCovMatrixWorks)
 {
     return;
@@ -150,6 +404,119 @@ TEST(statisticCalculationsTest, calculateCovMatrixWorks)
     }
 }
 
+TEST(statisticCalculationsTest, blockedCovarianceMatchesNaive)
+{
+    // sample count and dimension are not multiples of the block size
+    constexpr size_t dim = 7;
+    std::mt19937 rng{7};
+    std::uniform_real_distribution<double> dist{-5.0, 5.0};
+    std::vector<mnv::valueVector<double, dim>> values(1000);
+    for (auto &value : values)
+    {
+        for (auto &x : value)
+        {
+            x = dist(rng) + 100.0;
+        }
+    }
+
+    const auto mean = mnv::calculateMeanVector(values);
+    mnv::MatrixSq<double, dim> naive{};
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            for (auto &&value : values)
+            {
+                naive[i][j] += (value[i] - mean[i]) * (value[j] - mean[j]);
+            }
+            naive[i][j] /= static_cast<double>(values.size() - 1);
+        }
+    }
+
+    for (size_t threads : {size_t{1}, size_t{3}, size_t{0}})
+    {
+        const auto cov = mnv::calculateCovarianceMatrix(values, threads);
+        for (size_t i = 0; i < dim; i++)
+        {
+            for (size_t j = 0; j < dim; j++)
+            {
+                EXPECT_NEAR(cov[i][j], naive[i][j], 1e-10) << "i and j were " << i << " " << j << std::endl;
+                EXPECT_EQ(cov[i][j], cov[j][i]);
+            }
+        }
+    }
+    EXPECT_EQ(mnv::calculateCovarianceMatrix(values, 3), mnv::calculateCovarianceMatrix(values, 3));
+}
+
+TEST(statisticCalculationsTest, covarianceAccumulatorWorks)
+{
+    const std::vector<mnv::valueVector<double, 3>> stats = {
+        {75, 10.5, 45},
+        {65, 12.8, 65},
+        {22, 7.3, 74},
+        {15, 2.1, 76},
+        {18, 9.2, 56}};
+
+    const auto expectedCov = mnv::calculateCovarianceMatrix(stats);
+    const auto expectedMean = mnv::calculateMeanVector(stats);
+
+    mnv::CovarianceAccumulator<double, 3> single{};
+    for (auto &&sample : stats)
+    {
+        single.add(sample);
+    }
+
+    mnv::CovarianceAccumulator<double, 3> batch{};
+    batch.add(stats);
+
+    // two partial accumulators, one fed in a batch and one value by value
+    mnv::CovarianceAccumulator<double, 3> first{};
+    mnv::CovarianceAccumulator<double, 3> second{};
+    first.add(stats.data(), 2);
+    for (size_t k = 2; k < stats.size(); k++)
+    {
+        second.add(stats[k]);
+    }
+    first.merge(second);
+
+    for (auto const *accumulator : {&single, &batch, &first})
+    {
+        EXPECT_EQ(accumulator->count(), stats.size());
+        const auto cov = accumulator->covariance();
+        const auto mean = accumulator->mean();
+        for (size_t i = 0; i < 3; i++)
+        {
+            EXPECT_NEAR(mean[i], expectedMean[i], 1e-9);
+            for (size_t j = 0; j < 3; j++)
+            {
+                EXPECT_NEAR(cov[i][j], expectedCov[i][j], 1e-9) << "i and j were " << i << " " << j << std::endl;
+            }
+        }
+    }
+
+    mnv::CovarianceAccumulator<double, 3> empty{};
+    empty.merge(mnv::CovarianceAccumulator<double, 3>{});
+    EXPECT_EQ(empty.count(), 0u);
+    EXPECT_EQ(empty.covariance(), (mnv::MatrixSq<double, 3>{}));
+}
+
+TEST(statisticCalculationsTest, covarianceAccumulatorIsStable)
+{
+    // a large offset ruins the naive sum-of-squares formula, not Welford/Chan updates
+    mnv::CovarianceAccumulator<double, 2> accumulator{};
+    const double offset = 1e9;
+    for (int k = 0; k < 1000; k++)
+    {
+        const double x = (k % 2 == 0) ? 1.0 : -1.0;
+        accumulator.add(mnv::valueVector<double, 2>{offset + x, offset - x});
+    }
+
+    const auto cov = accumulator.covariance();
+    EXPECT_NEAR(cov[0][0], 1000.0 / 999.0, 1e-6);
+    EXPECT_NEAR(cov[1][0], -1000.0 / 999.0, 1e-6);
+    EXPECT_NEAR(accumulator.mean()[0], offset, 1e-6);
+}
+
 TEST(mnvGeneratorTest, buildWorks)
 {
     const mnv::MatrixSq<double, 3> posDef{{{2, -1, 2},
@@ -202,6 +569,17 @@ TEST(mnvGeneratorTest, build2Works)
     auto gen = mnv::MNVGenerator<double, 3>::build(stats, 0);
     auto genPtr = std::get_if<mnv::MNVGenerator<double, 3>>(&gen);
     EXPECT_NE(genPtr, nullptr);
+
+    mnv::CovarianceAccumulator<double, 3> accumulator{};
+    accumulator.add(statsNotEnoughInfo);
+    genFailed = mnv::MNVGenerator<double, 3>::build(accumulator, 0);
+    error = std::get<mnv::MNVGeneratorBuildError>(genFailed);
+    EXPECT_EQ(error.type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    accumulator.add(stats);
+    gen = mnv::MNVGenerator<double, 3>::build(accumulator, 0);
+    genPtr = std::get_if<mnv::MNVGenerator<double, 3>>(&gen);
+    EXPECT_NE(genPtr, nullptr);
 }
 
 TEST(mnvGeneratorTest, covarianceIsRight)
@@ -217,7 +595,7 @@ TEST(mnvGeneratorTest, covarianceIsRight)
     auto gen = std::get<mnv::MNVGenerator<double, 6>>(genPacked);
 
     std::vector<mnv::valueVector<double, 6>> values{};
-    size_t amountOfValues = 10000;
+    size_t amountOfValues = 200000;
     values.reserve(amountOfValues);
     for (size_t i = 0; i < amountOfValues; i++)
     {
@@ -239,4 +617,1734 @@ TEST(mnvGeneratorTest, covarianceIsRight)
     {
         EXPECT_NEAR(meanCalcualated[j], mean[j], 0.1);
     }
-}
\ No newline at end of file
+}
+
+TEST(mnvGeneratorTest, buildWorksForLargeDimensions)
+{
+    constexpr size_t dim = 64;
+    // Kac-Murdock-Szego matrix, positive-definite for |rho| < 1
+    auto covariance = std::make_unique<mnv::MatrixSq<double, dim>>();
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            (*covariance)[i][j] = std::pow(0.5, std::abs(static_cast<double>(i) - static_cast<double>(j)));
+        }
+    }
+    const mnv::valueVector<double, dim> mean{};
+
+    auto gen = mnv::MNVGenerator<double, dim>::build(*covariance, mean, 1);
+    auto genPtr = std::get_if<mnv::MNVGenerator<double, dim>>(&gen);
+    EXPECT_NE(genPtr, nullptr);
+
+    (*covariance)[dim - 1][dim - 1] = -1;
+    gen = mnv::MNVGenerator<double, dim>::build(*covariance, mean, 1);
+    ASSERT_TRUE(std::holds_alternative<mnv::MNVGeneratorBuildError>(gen));
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(gen).type,
+              mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+}
+
+TEST(mnvGeneratorTest, nextValuesMatchesNextValue)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+
+    auto single = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 7));
+    auto batched = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 7));
+
+    // not a multiple of any block size used internally
+    const size_t amountOfValues = 1237;
+    std::vector<mnv::valueVector<double, 6>> values(amountOfValues);
+    batched.nextValues(values.data(), values.size());
+
+    for (size_t i = 0; i < amountOfValues; i++)
+    {
+        ASSERT_EQ(single.nextValue(), values[i]) << "value " << i << " differs" << std::endl;
+    }
+
+    std::vector<double> flat(3 * 6);
+    batched.nextValues(flat.data(), 3);
+    for (size_t i = 0; i < 3; i++)
+    {
+        const auto expected = single.nextValue();
+        for (size_t j = 0; j < 6; j++)
+        {
+            ASSERT_EQ(flat[i * 6 + j], expected[j]);
+        }
+    }
+}
+
+TEST(mnvGeneratorTest, philoxEngineWorks)
+{
+    using Generator = mnv::MNVGenerator<double, 6, mnv::Philox4x32>;
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+
+    auto genPacked = Generator::build(testMatrix, mean, 1);
+    ASSERT_FALSE(std::holds_alternative<mnv::MNVGeneratorBuildError>(genPacked));
+    auto gen = std::get<Generator>(genPacked);
+
+    std::vector<mnv::valueVector<double, 6>> values(200000);
+    gen.nextValues(values.data(), values.size());
+
+    auto cov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < cov.size(); i++)
+    {
+        for (size_t j = 0; j < cov.size(); j++)
+        {
+            EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.1) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+
+    // a different stream gives a different sequence, the same stream repeats it
+    auto other = std::get<Generator>(Generator::build(testMatrix, mean, 1));
+    other.engine().stream(1);
+    EXPECT_NE(other.nextValue(), values[0]);
+    other.engine().stream(0);
+    EXPECT_EQ(other.nextValue(), values[0]);
+}
+
+TEST(mnvGeneratorTest, generateParallelDoesNotDependOnThreadCount)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto reference = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 3));
+
+    // not a multiple of the chunk size
+    const size_t amountOfValues = 5000;
+    std::vector<mnv::valueVector<double, 6>> expected(amountOfValues);
+    reference.generateParallel(expected.data(), amountOfValues, 1);
+
+    for (size_t threads : {size_t{2}, size_t{3}, size_t{8}, size_t{0}})
+    {
+        auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 3));
+        std::vector<mnv::valueVector<double, 6>> values(amountOfValues);
+        gen.generateParallel(values.data(), amountOfValues, threads);
+        EXPECT_EQ(values, expected) << "threads " << threads;
+    }
+
+    // the next call continues with fresh substreams
+    std::vector<mnv::valueVector<double, 6>> next(amountOfValues);
+    reference.generateParallel(next.data(), amountOfValues, 4);
+    EXPECT_NE(next[0], expected[0]);
+
+    // and the sequential stream is independent of them
+    auto sequential = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 3));
+    EXPECT_NE(sequential.nextValue(), expected[0]);
+}
+
+TEST(mnvGeneratorTest, runParallelPropagatesExceptions)
+{
+    // a task throwing on a helper or on the calling thread reaches the caller after all threads are done
+    for (size_t failing : {size_t{0}, size_t{500}, size_t{999}})
+    {
+        std::vector<std::atomic<int>> runs(1000);
+        EXPECT_THROW(mnv::internal::runParallel(runs.size(), 4, [&](size_t index)
+                                                {
+            runs[index]++;
+            if (index == failing)
+            {
+                throw std::runtime_error("task failed");
+            } }),
+                     std::runtime_error);
+        for (auto &&run : runs)
+        {
+            EXPECT_LE(run.load(), 1);
+        }
+    }
+
+    // nested calls find the pool busy and run on threads of their own, failing the same way
+    EXPECT_THROW(mnv::internal::runParallel(2, 2, [&](size_t)
+                                            { mnv::internal::runParallel(8, 3, [&](size_t index)
+                                                                         {
+                if (index == 3)
+                {
+                    throw std::runtime_error("inner task failed");
+                } }); }),
+                 std::runtime_error);
+
+    // the pool is free again afterwards and every index runs exactly once
+    std::atomic<int> pooled{0};
+    EXPECT_TRUE(mnv::internal::WorkerPool::instance().tryRun(3, [&]()
+                                                             { pooled++; }));
+    EXPECT_EQ(pooled.load(), 4);
+
+    std::vector<std::atomic<int>> runs(1000);
+    mnv::internal::runParallel(runs.size(), 4, [&](size_t index)
+                               { runs[index]++; });
+    for (auto &&run : runs)
+    {
+        EXPECT_EQ(run.load(), 1);
+    }
+}
+
+TEST(mnvGeneratorTest, generateParallelCovarianceIsRight)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::MNVGenerator<double, 6, mnv::Philox4x32>>(
+        mnv::MNVGenerator<double, 6, mnv::Philox4x32>::build(testMatrix, mean, 5));
+
+    std::vector<mnv::valueVector<double, 6>> values(200000);
+    gen.generateParallel(values.data(), values.size(), 4);
+
+    auto cov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < cov.size(); i++)
+    {
+        for (size_t j = 0; j < cov.size(); j++)
+        {
+            EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.1) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+
+    auto meanCalculated = mnv::calculateMeanVector(values);
+    for (size_t j = 0; j < meanCalculated.size(); j++)
+    {
+        EXPECT_NEAR(meanCalculated[j], mean[j], 0.1);
+    }
+}
+
+TEST(dynamicMnvGeneratorTest, buildWorks)
+{
+    static_assert(!std::is_copy_constructible_v<mnv::DynamicMNVGenerator<double>>);
+    static_assert(std::is_nothrow_move_constructible_v<mnv::DynamicMNVGenerator<double>>);
+
+    const std::vector<double> posDef{2, -1, 2,
+                                     -1, 1, -3,
+                                     2, -3, 11};
+    const std::vector<double> negDef{-2, 1, 0,
+                                     1, -2, 0,
+                                     0, 0, -2};
+    const std::vector<double> assymetric{-2, 2, 1,
+                                         2, -2, 0,
+                                         0, 0, -8};
+    const std::vector<double> mean{1, 1, 1};
+
+    auto genFailed = mnv::DynamicMNVGenerator<double>::build(negDef, mean, 0);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    genFailed = mnv::DynamicMNVGenerator<double>::build(assymetric, mean, 0);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric);
+
+    genFailed = mnv::DynamicMNVGenerator<double>::build(posDef, std::vector<double>{1, 1}, 0);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+
+    auto gen = mnv::DynamicMNVGenerator<double>::build(posDef, mean, 0);
+    auto genPtr = std::get_if<mnv::DynamicMNVGenerator<double>>(&gen);
+    ASSERT_NE(genPtr, nullptr);
+    EXPECT_EQ(genPtr->dimension(), 3u);
+    EXPECT_EQ(genPtr->nextValue().size(), 3u);
+}
+
+TEST(dynamicMnvGeneratorTest, matchesStaticGenerator)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    std::vector<double> covariance{};
+    for (auto &&row : testMatrix)
+    {
+        covariance.insert(covariance.end(), row.begin(), row.end());
+    }
+
+    auto fixed = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 11));
+    auto dynamic = std::get<mnv::DynamicMNVGenerator<double>>(
+        mnv::DynamicMNVGenerator<double>::build(covariance.data(), mean.data(), mean.size(), 11));
+
+    // moving keeps the state
+    auto moved = std::move(dynamic);
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        const auto expected = fixed.nextValue();
+        const auto value = moved.nextValue();
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), value.begin(), value.end())) << "value " << i;
+    }
+
+    std::vector<mnv::valueVector<double, 6>> expected(3000);
+    fixed.generateParallel(expected.data(), expected.size(), 3);
+    std::vector<double> values(3000 * 6);
+    moved.generateParallel(values.data(), 3000, 2);
+    EXPECT_EQ(std::memcmp(values.data(), expected.data(), values.size() * sizeof(double)), 0);
+}
+
+TEST(dynamicMnvGeneratorTest, covarianceIsRightForLargeDimensions)
+{
+    const size_t dim = 200;
+    std::vector<double> covariance(dim * dim);
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            covariance[i * dim + j] = std::pow(0.5, std::abs(static_cast<double>(i) - static_cast<double>(j)));
+        }
+    }
+    const std::vector<double> mean(dim, 1.0);
+
+    auto gen = std::get<mnv::DynamicMNVGenerator<double, mnv::Philox4x32>>(
+        mnv::DynamicMNVGenerator<double, mnv::Philox4x32>::build(covariance, mean, 3));
+
+    const size_t amountOfValues = 100000;
+    std::vector<double> values(amountOfValues * dim);
+    gen.generateParallel(values.data(), amountOfValues);
+
+    // spot-check a few entries close to and far from the diagonal
+    for (auto [i, j] : {std::pair<size_t, size_t>{0, 0}, {10, 11}, {100, 102}, {199, 150}})
+    {
+        double sum = 0;
+        for (size_t k = 0; k < amountOfValues; k++)
+        {
+            sum += (values[k * dim + i] - 1.0) * (values[k * dim + j] - 1.0);
+        }
+        EXPECT_NEAR(sum / static_cast<double>(amountOfValues), covariance[i * dim + j], 0.02) << "i and j were " << i << " " << j;
+    }
+}
+
+TEST(factorMnvGeneratorTest, buildWorks)
+{
+    const mnv::MatrixRect<double, 4, 2> loadings{{{1.0, 0.5},
+                                                  {0.8, -0.3},
+                                                  {0.0, 1.2},
+                                                  {-0.4, 0.4}}};
+    const mnv::valueVector<double, 4> mean{{1, 2, 3, 4}};
+
+    auto genFailed = mnv::FactorMNVGenerator<double, 4, 2>::build(loadings, {{0.5, 0.0, 0.2, 0.1}}, mean, 1);
+    auto error = std::get<mnv::MNVGeneratorBuildError>(genFailed);
+    EXPECT_EQ(error.type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    auto gen = mnv::FactorMNVGenerator<double, 4, 2>::build(loadings, {{0.5, 0.3, 0.2, 0.1}}, mean, 1);
+    auto genPtr = std::get_if<mnv::FactorMNVGenerator<double, 4, 2>>(&gen);
+    ASSERT_NE(genPtr, nullptr);
+
+    const auto cov = genPtr->covariance();
+    EXPECT_DOUBLE_EQ(cov[0][0], 1.0 + 0.25 + 0.5);
+    EXPECT_DOUBLE_EQ(cov[1][0], 0.8 - 0.15);
+    EXPECT_DOUBLE_EQ(cov[0][1], cov[1][0]);
+    EXPECT_DOUBLE_EQ(cov[3][3], 0.16 + 0.16 + 0.1);
+
+    // the model covariance is a valid input for the dense generator as well
+    auto dense = mnv::MNVGenerator<double, 4>::build(cov, mean, 1);
+    auto densePtr = std::get_if<mnv::MNVGenerator<double, 4>>(&dense);
+    EXPECT_NE(densePtr, nullptr);
+}
+
+TEST(factorMnvGeneratorTest, covarianceIsRight)
+{
+    constexpr size_t dim = 12;
+    constexpr size_t factors = 3;
+    mnv::MatrixRect<double, dim, factors> loadings{};
+    mnv::valueVector<double, dim> variances{};
+    mnv::valueVector<double, dim> mean{};
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t f = 0; f < factors; f++)
+        {
+            loadings[i][f] = std::sin(static_cast<double>(i * factors + f + 1));
+        }
+        variances[i] = 0.1 + 0.05 * static_cast<double>(i);
+        mean[i] = static_cast<double>(i);
+    }
+
+    auto gen = std::get<mnv::FactorMNVGenerator<double, dim, factors>>(
+        mnv::FactorMNVGenerator<double, dim, factors>::build(loadings, variances, mean, 3));
+
+    std::vector<mnv::valueVector<double, dim>> values(200000);
+    gen.nextValues(values.data(), values.size());
+
+    const auto expected = gen.covariance();
+    const auto cov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            EXPECT_NEAR(cov[i][j], expected[i][j], 0.05) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+
+    const auto meanCalculated = mnv::calculateMeanVector(values);
+    for (size_t j = 0; j < dim; j++)
+    {
+        EXPECT_NEAR(meanCalculated[j], mean[j], 0.05);
+    }
+
+    // batched generation consumes the engine exactly like nextValue()
+    gen.seed(11);
+    std::vector<mnv::valueVector<double, dim>> batch(5);
+    gen.nextValues(batch.data(), batch.size());
+    gen.seed(11);
+    for (auto &&value : batch)
+    {
+        EXPECT_EQ(gen.nextValue(), value);
+    }
+}
+
+namespace
+{
+    // dense row-major matrix -> CSR, exact zeros are dropped
+    mnv::SparseMatrix<double> toSparse(std::vector<double> const &dense, size_t dim)
+    {
+        mnv::SparseMatrix<double> result{};
+        result.dim = dim;
+        result.rowOffsets.push_back(0);
+        for (size_t i = 0; i < dim; i++)
+        {
+            for (size_t j = 0; j < dim; j++)
+            {
+                if (dense[i * dim + j] != 0)
+                {
+                    result.columns.push_back(j);
+                    result.values.push_back(dense[i * dim + j]);
+                }
+            }
+            result.rowOffsets.push_back(result.columns.size());
+        }
+        return result;
+    }
+} // namespace
+
+TEST(sparseMnvGeneratorTest, buildWorks)
+{
+    // tridiagonal, diagonally dominant
+    const std::vector<double> bands{0, 2,
+                                    -1, 2,
+                                    -1, 2,
+                                    -1, 2};
+    const std::vector<double> mean{1, 2, 3, 4};
+
+    auto gen = mnv::SparseMNVGenerator<double>::build(bands, 1, mean, 1);
+    auto genPtr = std::get_if<mnv::SparseMNVGenerator<double>>(&gen);
+    ASSERT_NE(genPtr, nullptr);
+    EXPECT_EQ(genPtr->dimension(), 4u);
+    EXPECT_EQ(genPtr->factorNonZeros(), 7u);
+
+    auto genFailed = mnv::SparseMNVGenerator<double>::build(bands, 2, mean, 1);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+
+    const std::vector<double> indefiniteBands{0, 1,
+                                              -2, 1,
+                                              -1, 2,
+                                              -1, 2};
+    genFailed = mnv::SparseMNVGenerator<double>::build(indefiniteBands, 1, mean, 1);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    auto assymetric = toSparse({2, -1, 0,
+                                0, 2, -1,
+                                0, -1, 2},
+                               3);
+    genFailed = mnv::SparseMNVGenerator<double>::build(assymetric, {0, 0, 0}, 1);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric);
+
+    assymetric.columns[0] = 3;
+    genFailed = mnv::SparseMNVGenerator<double>::build(assymetric, {0, 0, 0}, 1);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(genFailed).type, mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+
+    // 10^5 components with a narrow band, the factor keeps the band
+    const size_t dim = 100000;
+    std::vector<double> wideBands(dim * 3);
+    for (size_t i = 0; i < dim; i++)
+    {
+        wideBands[i * 3] = 0.25;
+        wideBands[i * 3 + 1] = -0.5;
+        wideBands[i * 3 + 2] = 2;
+    }
+    auto large = mnv::SparseMNVGenerator<double>::build(wideBands, 2, std::vector<double>(dim, 0.0), 1);
+    auto largePtr = std::get_if<mnv::SparseMNVGenerator<double>>(&large);
+    ASSERT_NE(largePtr, nullptr);
+    EXPECT_EQ(largePtr->factorNonZeros(), dim * 3 - 3);
+    EXPECT_EQ(largePtr->nextValue().size(), dim);
+}
+
+TEST(sparseMnvGeneratorTest, reverseCuthillMcKeeReducesFill)
+{
+    // tridiagonal matrix with scrambled components, the natural order fills in the factor
+    const size_t dim = 200;
+    std::vector<size_t> scramble(dim);
+    for (size_t i = 0; i < dim; i++)
+    {
+        scramble[i] = (i * 73) % dim;
+    }
+    std::vector<double> dense(dim * dim, 0.0);
+    for (size_t i = 0; i < dim; i++)
+    {
+        dense[scramble[i] * dim + scramble[i]] = 2;
+        if (i + 1 < dim)
+        {
+            dense[scramble[i] * dim + scramble[i + 1]] = -1;
+            dense[scramble[i + 1] * dim + scramble[i]] = -1;
+        }
+    }
+    const auto sparse = toSparse(dense, dim);
+    const std::vector<double> mean(dim, 0.0);
+
+    auto natural = std::get<mnv::SparseMNVGenerator<double>>(
+        mnv::SparseMNVGenerator<double>::build(sparse, mean, 1, mnv::SparseOrdering::Natural));
+    auto reordered = std::get<mnv::SparseMNVGenerator<double>>(
+        mnv::SparseMNVGenerator<double>::build(sparse, mean, 1));
+
+    EXPECT_EQ(reordered.factorNonZeros(), 2 * dim - 1);
+    EXPECT_GT(natural.factorNonZeros(), reordered.factorNonZeros());
+}
+
+TEST(sparseMnvGeneratorTest, covarianceIsRight)
+{
+    std::vector<double> dense;
+    for (auto &&row : testMatrix)
+    {
+        dense.insert(dense.end(), row.begin(), row.end());
+    }
+    const std::vector<double> mean{0, 2, 4, 8, 16, 32};
+
+    for (auto ordering : {mnv::SparseOrdering::Natural, mnv::SparseOrdering::ReverseCuthillMcKee})
+    {
+        auto gen = std::get<mnv::SparseMNVGenerator<double>>(
+            mnv::SparseMNVGenerator<double>::build(toSparse(dense, 6), mean, 5, ordering));
+
+        std::vector<mnv::valueVector<double, 6>> values(200000);
+        gen.nextValues(values.data()->data(), values.size());
+
+        auto cov = mnv::calculateCovarianceMatrix(values);
+        for (size_t i = 0; i < cov.size(); i++)
+        {
+            for (size_t j = 0; j < cov.size(); j++)
+            {
+                EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.1) << "i and j were " << i << " " << j << std::endl;
+            }
+        }
+
+        auto meanCalculated = mnv::calculateMeanVector(values);
+        for (size_t j = 0; j < meanCalculated.size(); j++)
+        {
+            EXPECT_NEAR(meanCalculated[j], mean[j], 0.1);
+        }
+    }
+}
+
+TEST(sparseMnvGeneratorTest, precisionMatrixWorks)
+{
+    // stationary AR(1) with rho = 0.5: the precision matrix is tridiagonal,
+    // covariance[i][j] = rho^|i - j| / (1 - rho^2)
+    constexpr size_t dim = 5;
+    const double rho = 0.5;
+    std::vector<double> precision(dim * dim, 0.0);
+    for (size_t i = 0; i < dim; i++)
+    {
+        precision[i * dim + i] = (i == 0 || i == dim - 1) ? 1.0 : 1.0 + rho * rho;
+        if (i + 1 < dim)
+        {
+            precision[i * dim + i + 1] = -rho;
+            precision[(i + 1) * dim + i] = -rho;
+        }
+    }
+    const std::vector<double> mean{1, -1, 2, -2, 3};
+
+    auto failed = mnv::SparseMNVGenerator<double>::buildFromPrecision(toSparse(precision, dim), {0, 0}, 1);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(failed).type, mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+
+    auto gen = std::get<mnv::SparseMNVGenerator<double>>(
+        mnv::SparseMNVGenerator<double>::buildFromPrecision(toSparse(precision, dim), mean, 9));
+    EXPECT_EQ(gen.factorNonZeros(), 2 * dim - 1);
+
+    std::vector<mnv::valueVector<double, dim>> values(200000);
+    gen.nextValues(values.data()->data(), values.size());
+
+    const auto cov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            const double expected = std::pow(rho, std::abs(static_cast<double>(i) - static_cast<double>(j))) / (1 - rho * rho);
+            EXPECT_NEAR(cov[i][j], expected, 0.05) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+
+    const auto meanCalculated = mnv::calculateMeanVector(values);
+    for (size_t j = 0; j < dim; j++)
+    {
+        EXPECT_NEAR(meanCalculated[j], mean[j], 0.05);
+    }
+}
+
+TEST(sparseMnvGeneratorTest, nextValuesMatchesNextValue)
+{
+    std::vector<double> dense;
+    for (auto &&row : testMatrix)
+    {
+        dense.insert(dense.end(), row.begin(), row.end());
+    }
+    const std::vector<double> mean{0, 2, 4, 8, 16, 32};
+
+    // more values than a single batch, and a partial one at the end
+    for (bool isPrecision : {false, true})
+    {
+        auto gen = std::get<mnv::SparseMNVGenerator<double>>(
+            isPrecision ? mnv::SparseMNVGenerator<double>::buildFromPrecision(toSparse(dense, 6), mean, 3)
+                        : mnv::SparseMNVGenerator<double>::build(toSparse(dense, 6), mean, 3));
+
+        std::vector<double> batch(37 * 6);
+        gen.nextValues(batch.data(), 37);
+
+        gen.seed(3);
+        for (size_t k = 0; k < 37; k++)
+        {
+            const auto value = gen.nextValue();
+            for (size_t i = 0; i < 6; i++)
+            {
+                EXPECT_EQ(value[i], batch[k * 6 + i]);
+            }
+        }
+    }
+}
+
+namespace
+{
+    template <typename Generator>
+    void expectSameValues(Generator &a, Generator &b, size_t seed, double tolerance)
+    {
+        a.seed(seed);
+        b.seed(seed);
+        for (size_t k = 0; k < 100; k++)
+        {
+            const auto valueA = a.nextValue();
+            const auto valueB = b.nextValue();
+            for (size_t i = 0; i < valueA.size(); i++)
+            {
+                EXPECT_NEAR(valueA[i], valueB[i], tolerance);
+            }
+        }
+    }
+} // namespace
+
+TEST(mnvGeneratorTest, rankOneUpdateWorks)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    const mnv::valueVector<double, 6> v{{0.5, -1, 0.25, 2, 0, -0.75}};
+    auto updatedMatrix = testMatrix;
+    for (size_t i = 0; i < 6; i++)
+    {
+        for (size_t j = 0; j < 6; j++)
+        {
+            updatedMatrix[i][j] += v[i] * v[j];
+        }
+    }
+
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 1));
+    auto original = gen;
+    auto expected = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(updatedMatrix, mean, 1));
+
+    gen.update(v);
+    expectSameValues(gen, expected, 4, 1e-9);
+
+    EXPECT_FALSE(gen.downdate(v).has_value());
+    expectSameValues(gen, original, 4, 1e-9);
+
+    // removing more than there is must fail and leave the generator as it was
+    mnv::valueVector<double, 6> tooLarge = v;
+    for (auto &x : tooLarge)
+    {
+        x *= 10;
+    }
+    const auto error = gen.downdate(tooLarge);
+    ASSERT_TRUE(error.has_value());
+    EXPECT_EQ(error->type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+    expectSameValues(gen, original, 4, 1e-9);
+}
+
+TEST(mnvGeneratorTest, exponentialUpdateWorks)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    const mnv::valueVector<double, 6> observation{{1, 1, 5, 7, 15, 30}};
+    const double decay = 0.9;
+
+    auto expectedMatrix = testMatrix;
+    mnv::valueVector<double, 6> expectedMean{};
+    for (size_t i = 0; i < 6; i++)
+    {
+        expectedMean[i] = decay * mean[i] + (1 - decay) * observation[i];
+        for (size_t j = 0; j < 6; j++)
+        {
+            expectedMatrix[i][j] = decay * testMatrix[i][j] +
+                                   decay * (1 - decay) * (observation[i] - mean[i]) * (observation[j] - mean[j]);
+        }
+    }
+
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 1));
+    auto expected = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(expectedMatrix, expectedMean, 1));
+
+    EXPECT_EQ(gen.observe(observation, 0.0).value().type, mnv::MNVGeneratorBuildError::type::DecayIsOutOfRange);
+    EXPECT_EQ(gen.observe(observation, 1.5).value().type, mnv::MNVGeneratorBuildError::type::DecayIsOutOfRange);
+    EXPECT_FALSE(gen.observe(observation, decay).has_value());
+    expectSameValues(gen, expected, 8, 1e-9);
+
+    // the runtime-sized generator shares the kernels
+    std::vector<double> covariance;
+    for (auto &&row : testMatrix)
+    {
+        covariance.insert(covariance.end(), row.begin(), row.end());
+    }
+    auto dynamic = std::get<mnv::DynamicMNVGenerator<double>>(
+        mnv::DynamicMNVGenerator<double>::build(covariance, std::vector<double>(mean.begin(), mean.end()), 1));
+    EXPECT_FALSE(dynamic.observe(observation.data(), decay).has_value());
+    dynamic.update(observation.data());
+    EXPECT_FALSE(dynamic.downdate(observation.data()).has_value());
+
+    gen.seed(8);
+    dynamic.seed(8);
+    for (size_t k = 0; k < 100; k++)
+    {
+        const auto valueA = gen.nextValue();
+        const auto valueB = dynamic.nextValue();
+        for (size_t i = 0; i < 6; i++)
+        {
+            EXPECT_NEAR(valueA[i], valueB[i], 1e-9);
+        }
+    }
+}
+
+namespace
+{
+    constexpr mnv::MatrixSq<double, 3> constexprCovariance{{{2, -1, 2},
+                                                            {-1, 1, -3},
+                                                            {2, -3, 11}}};
+    constexpr mnv::MatrixSq<double, 3> constexprIndefinite{{{-2, 1, 0},
+                                                            {1, -2, 0},
+                                                            {0, 0, -2}}};
+    constexpr mnv::MatrixSq<double, 3> constexprAssymetric{{{2, 1, 0},
+                                                            {0, 2, 0},
+                                                            {0, 0, 2}}};
+} // namespace
+
+TEST(constexprBuildTest, constexprSqrtWorks)
+{
+    static_assert(mnv::internal::constexprSqrt(4.0) == 2.0);
+    static_assert(mnv::internal::constexprSqrt(0.0) == 0.0);
+    static_assert(mnv::internal::constexprSqrt(2.25f) == 1.5f);
+
+    for (double x : {1e-300, 1e-10, 0.3, 1.0, 2.0, 3.0, 1e10, 1e300})
+    {
+        EXPECT_DOUBLE_EQ(mnv::internal::constexprSqrt(x), std::sqrt(x)) << "x was " << x;
+    }
+    EXPECT_TRUE(std::isnan(mnv::internal::constexprSqrt(-1.0)));
+}
+
+TEST(constexprBuildTest, factorIsComputedAtCompileTime)
+{
+    static_assert(mnv::internal::isMatrixSymmetric(constexprCovariance));
+    static_assert(!mnv::internal::isMatrixSymmetric(constexprAssymetric));
+
+    static constexpr auto factor = mnv::makeCovarianceFactor(constexprCovariance);
+    static_assert(factor.valid);
+    static_assert(!mnv::makeCovarianceFactor(constexprIndefinite).valid);
+    static_assert(mnv::makeCovarianceFactor(constexprIndefinite).error == mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+    static_assert(mnv::makeCovarianceFactor(constexprAssymetric).error == mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric);
+
+    // the same factor as the runtime decomposition, up to rounding of the square root
+    mnv::MatrixLowerTriangular<double, 3> runtimeFactor{};
+    ASSERT_TRUE(mnv::internal::tryCholetskyDecomposition(constexprCovariance, runtimeFactor));
+    for (size_t i = 0; i < runtimeFactor.size(); i++)
+    {
+        EXPECT_DOUBLE_EQ(factor.lower[i], runtimeFactor[i]);
+        EXPECT_DOUBLE_EQ(mnv::staticCovarianceFactor<constexprCovariance>.lower[i], runtimeFactor[i]);
+    }
+
+    const mnv::valueVector<double, 3> mean{{1, 2, 3}};
+    auto fromFactor = std::get<mnv::MNVGenerator<double, 3>>(mnv::MNVGenerator<double, 3>::build(factor, mean, 5));
+    auto fromMatrix = std::get<mnv::MNVGenerator<double, 3>>(mnv::MNVGenerator<double, 3>::build(constexprCovariance, mean, 5));
+    for (size_t k = 0; k < 100; k++)
+    {
+        const auto a = fromFactor.nextValue();
+        const auto b = fromMatrix.nextValue();
+        for (size_t i = 0; i < 3; i++)
+        {
+            EXPECT_NEAR(a[i], b[i], 1e-12);
+        }
+    }
+
+    auto failed = mnv::MNVGenerator<double, 3>::build(mnv::makeCovarianceFactor(constexprAssymetric), mean, 5);
+    EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(failed).type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotSymmetric);
+}
+
+TEST(quasiMnvGeneratorTest, sobolSequenceWorks)
+{
+    // amounts of primitive polynomials of degree 1 ... 8
+    const size_t primitiveCounts[] = {1, 1, 2, 2, 6, 6, 18, 16};
+    for (size_t degree = 1; degree <= 8; degree++)
+    {
+        size_t count = 0;
+        for (std::uint64_t middle = 0; middle < (std::uint64_t{1} << (degree - 1)); middle++)
+        {
+            count += mnv::internal::isPolynomialPrimitive((std::uint64_t{1} << degree) | (middle << 1) | 1, degree);
+        }
+        EXPECT_EQ(count, primitiveCounts[degree - 1]) << "degree was " << degree;
+    }
+
+    // the direction numbers of the Joe-Kuo table, m_j = v_j >> (32 - j), checked past the initial ones as well
+    const auto tabulated = mnv::internal::makeSobolDirections(mnv::internal::sobolTableDims);
+    const std::vector<std::pair<size_t, std::vector<std::uint32_t>>> joeKuo{
+        {2, {1, 3, 3, 9, 29, 23, 71, 197, 209, 627, 1907, 1369}},
+        {5, {1, 1, 3, 3, 25, 9, 43, 251, 449, 449, 1347, 323}},
+        {100, {1, 3, 3, 7, 29, 37, 33, 123, 147, 243, 1153, 1413}},
+        {1023, {1, 1, 5, 11, 11, 33, 37, 29, 263, 1019, 657, 1453}}};
+    for (auto &&[d, expected] : joeKuo)
+    {
+        for (size_t j = 0; j < expected.size(); j++)
+        {
+            EXPECT_EQ(tabulated[d * 32 + j] >> (31 - j), expected[j]) << "dimension and j were " << d << " " << j;
+        }
+    }
+
+    // every dimension, scrambled or not, puts exactly one of the first 2^m points into each interval of length 2^-m
+    constexpr size_t dims = 40;
+    constexpr size_t m = 8;
+    const auto directions = mnv::internal::makeSobolDirections(dims);
+    for (std::uint32_t scramble : {0u, 0x12345678u})
+    {
+        for (size_t d = 0; d < dims; d++)
+        {
+            std::vector<int> hits(size_t{1} << m, 0);
+            std::uint32_t point = 0;
+            for (std::uint64_t index = 0; index < (std::uint64_t{1} << m); index++)
+            {
+                const std::uint64_t gray = index ^ (index >> 1);
+                point = 0;
+                for (size_t j = 0; j < 32; j++)
+                {
+                    if ((gray >> j) & 1)
+                    {
+                        point ^= directions[d * 32 + j];
+                    }
+                }
+                const std::uint32_t value = scramble ? mnv::internal::owenScramble(point, scramble) : point;
+                hits[value >> (32 - m)]++;
+            }
+            EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 1 << m) << "dimension was " << d;
+        }
+    }
+}
+
+TEST(quasiMnvGeneratorTest, inverseNormalCdfIsAccurate)
+{
+    std::vector<double> uniforms;
+    for (double p : {1e-12, 1e-6, 0.001, 0.02, 0.02425, 0.1, 0.3, 0.5, 0.7, 0.9, 0.97575, 0.99, 0.999999})
+    {
+        uniforms.push_back(p);
+    }
+    std::vector<double> normals(uniforms.size());
+    mnv::internal::inverseNormalCdf(uniforms.data(), normals.data(), uniforms.size());
+
+    for (size_t i = 0; i < uniforms.size(); i++)
+    {
+        // one more Halley step with the exact CDF must not change anything
+        const double x = normals[i];
+        const double e = 0.5 * std::erfc(-x / std::sqrt(2.0)) - uniforms[i];
+        const double u = e * std::sqrt(2 * M_PI) * std::exp(x * x / 2);
+        const double refined = x - u / (1 + x * u / 2);
+        EXPECT_NEAR(x, refined, 1e-13 * std::max(1.0, std::abs(refined))) << "p was " << uniforms[i];
+    }
+    EXPECT_EQ(normals[7], 0.0);
+}
+
+TEST(quasiMnvGeneratorTest, skipAheadWorks)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::QuasiMNVGenerator<double, 6>>(mnv::QuasiMNVGenerator<double, 6>::build(testMatrix, mean, 3));
+
+    std::vector<mnv::valueVector<double, 6>> sequential(3000);
+    gen.nextValues(sequential.data(), 1000);
+    for (size_t k = 1000; k < 1500; k++)
+    {
+        sequential[k] = gen.nextValue();
+    }
+    gen.nextValues(sequential.data() + 1500, 1500);
+    EXPECT_EQ(gen.position(), 3000u);
+
+    std::vector<double> skipped(700 * 6);
+    gen.valuesAt(1234, skipped.data(), 700);
+    for (size_t k = 0; k < 700; k++)
+    {
+        for (size_t i = 0; i < 6; i++)
+        {
+            EXPECT_EQ(skipped[k * 6 + i], sequential[1234 + k][i]);
+        }
+    }
+
+    gen.seed(3);
+    std::vector<double> parallel(3000 * 6);
+    gen.generateParallel(parallel.data(), 3000, 4);
+    EXPECT_EQ(0, std::memcmp(parallel.data(), sequential.data(), parallel.size() * sizeof(double)));
+
+    // sequential values continue from wherever the position was moved to
+    gen.discard(29);
+    std::vector<double> after(6);
+    gen.valuesAt(3029, after.data(), 1);
+    const auto next = gen.nextValue();
+    EXPECT_EQ(0, std::memcmp(next.data(), after.data(), after.size() * sizeof(double)));
+
+    gen.seed(4);
+    EXPECT_NE(gen.nextValue(), sequential[0]);
+}
+
+TEST(quasiMnvGeneratorTest, convergesFasterThanMonteCarlo)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::QuasiMNVGenerator<double, 6>>(mnv::QuasiMNVGenerator<double, 6>::build(testMatrix, mean, 11));
+
+    // 4096 values: Monte Carlo gets the mean within about sqrt(7) / 64 = 0.04, the scrambled Sobol points much closer
+    std::vector<mnv::valueVector<double, 6>> values(4096);
+    gen.nextValues(values.data(), values.size());
+
+    const auto meanCalculated = mnv::calculateMeanVector(values);
+    for (size_t j = 0; j < meanCalculated.size(); j++)
+    {
+        EXPECT_NEAR(meanCalculated[j], mean[j], 0.005);
+    }
+
+    const auto cov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < cov.size(); i++)
+    {
+        for (size_t j = 0; j < cov.size(); j++)
+        {
+            EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.1) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+}
+
+TEST(mnvGeneratorTest, antitheticValuesWork)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 5));
+
+    // odd count, the last value has no partner
+    std::vector<mnv::valueVector<double, 6>> values(100001);
+    gen.nextAntitheticValues(values.data(), values.size());
+
+    for (size_t k = 0; k + 1 < values.size(); k += 2)
+    {
+        for (size_t j = 0; j < 6; j++)
+        {
+            ASSERT_NEAR(values[k][j] - mean[j], mean[j] - values[k + 1][j], 1e-12) << "pair " << k / 2;
+        }
+    }
+
+    // the first values of the pairs are an ordinary sample
+    std::vector<mnv::valueVector<double, 6>> firsts{};
+    for (size_t k = 0; k < values.size(); k += 2)
+    {
+        firsts.push_back(values[k]);
+    }
+    const auto cov = mnv::calculateCovarianceMatrix(firsts);
+    for (size_t i = 0; i < cov.size(); i++)
+    {
+        for (size_t j = 0; j < cov.size(); j++)
+        {
+            EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.1) << "i and j were " << i << " " << j << std::endl;
+        }
+    }
+
+    // whole pairs average to the mean
+    values.pop_back();
+    const auto meanCalculated = mnv::calculateMeanVector(values);
+    for (size_t j = 0; j < meanCalculated.size(); j++)
+    {
+        EXPECT_NEAR(meanCalculated[j], mean[j], 1e-9);
+    }
+}
+
+TEST(mnvGeneratorTest, momentMatchedValuesWork)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 5));
+
+    std::vector<mnv::valueVector<double, 6>> values(6);
+    const auto error = gen.nextMomentMatchedValues(values.data(), values.size());
+    ASSERT_TRUE(error.has_value());
+    EXPECT_EQ(error->type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    // even a tiny batch matches the moments exactly
+    for (size_t count : {size_t{7}, size_t{50}, size_t{10000}})
+    {
+        values.resize(count);
+        ASSERT_FALSE(gen.nextMomentMatchedValues(values.data(), values.size()).has_value());
+
+        const auto cov = mnv::calculateCovarianceMatrix(values);
+        for (size_t i = 0; i < cov.size(); i++)
+        {
+            for (size_t j = 0; j < cov.size(); j++)
+            {
+                EXPECT_NEAR(cov[i][j], testMatrix[i][j], 1e-9) << "i and j were " << i << " " << j << ", count " << count;
+            }
+        }
+
+        const auto meanCalculated = mnv::calculateMeanVector(values);
+        for (size_t j = 0; j < meanCalculated.size(); j++)
+        {
+            EXPECT_NEAR(meanCalculated[j], mean[j], 1e-9) << "count " << count;
+        }
+    }
+
+    // the dynamic generator shares the kernels
+    std::vector<double> covariance{};
+    for (auto &&row : testMatrix)
+    {
+        covariance.insert(covariance.end(), row.begin(), row.end());
+    }
+    auto dynamic = std::get<mnv::DynamicMNVGenerator<double>>(
+        mnv::DynamicMNVGenerator<double>::build(covariance.data(), mean.data(), mean.size(), 5));
+    auto fixed = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 5));
+
+    std::vector<mnv::valueVector<double, 6>> expected(21);
+    std::vector<double> dynamicValues(21 * 6);
+    fixed.nextAntitheticValues(expected.data(), expected.size());
+    dynamic.nextAntitheticValues(dynamicValues.data(), 21);
+    EXPECT_EQ(std::memcmp(dynamicValues.data(), expected.data(), dynamicValues.size() * sizeof(double)), 0);
+
+    ASSERT_FALSE(fixed.nextMomentMatchedValues(expected.data(), expected.size()).has_value());
+    ASSERT_FALSE(dynamic.nextMomentMatchedValues(dynamicValues.data(), 21).has_value());
+    EXPECT_EQ(std::memcmp(dynamicValues.data(), expected.data(), dynamicValues.size() * sizeof(double)), 0);
+}
+
+TEST(bufferedMnvGeneratorTest, buildWorks)
+{
+    const mnv::MatrixSq<double, 3> negDef{{{-2, 1, 0},
+                                           {1, -2, 0},
+                                           {0, 0, -2}}};
+    auto genFailed = mnv::BufferedMNVGenerator<double, 3>::build(negDef, {1, 1, 1}, 0);
+    auto errorPtr = std::get_if<mnv::MNVGeneratorBuildError>(&genFailed);
+    ASSERT_NE(errorPtr, nullptr);
+    EXPECT_EQ(errorPtr->type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    // capacity is rounded up to a power of two, the producer fills the ring up to the high watermark and stops there
+    auto gen = std::get<mnv::BufferedMNVGenerator<double, 6>>(
+        mnv::BufferedMNVGenerator<double, 6>::build(testMatrix, {}, 1, 100, 10, 90));
+    EXPECT_EQ(gen.capacity(), 128u);
+    while (gen.available() < 90)
+    {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(gen.available(), 90u);
+
+    // it sleeps until the low watermark is reached
+    std::vector<double> values(79 * 6);
+    gen.nextValues(values.data(), 79);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(gen.available(), 11u);
+    gen.nextValue();
+    while (gen.available() < 90)
+    {
+        std::this_thread::yield();
+    }
+}
+
+TEST(bufferedMnvGeneratorTest, sequenceIsDeterministic)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto reference = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 13));
+
+    // a tiny ring, so the consumer keeps catching up with the producer and the indices wrap many times
+    auto buffered = mnv::BufferedMNVGenerator<double, 6>::build(
+        std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 13)), 16, 4, 12);
+    auto moved = std::move(buffered);
+
+    std::vector<mnv::valueVector<double, 6>> batch(37);
+    for (size_t round = 0; round < 500; round++)
+    {
+        const auto value = moved.nextValue();
+        const auto expected = reference.nextValue();
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), value.begin(), value.end())) << "round " << round;
+
+        moved.nextValues(batch.data(), batch.size());
+        for (size_t k = 0; k < batch.size(); k++)
+        {
+            const auto expectedInBatch = reference.nextValue();
+            ASSERT_TRUE(std::equal(expectedInBatch.begin(), expectedInBatch.end(), batch[k].begin(), batch[k].end()))
+                << "round " << round << ", value " << k;
+        }
+    }
+}
+
+TEST(snapshotTest, saveAndLoadContinueTheSequence)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::MNVGenerator<double, 6, mnv::Philox4x32>>(
+        mnv::MNVGenerator<double, 6, mnv::Philox4x32>::build(testMatrix, mean, 21));
+
+    // odd amounts of values, so the engine is saved in the middle of a block
+    std::vector<mnv::valueVector<double, 6>> values(33);
+    gen.nextValues(values.data(), values.size());
+    gen.generateParallel(values.data(), values.size(), 2);
+
+    std::stringstream snapshot{};
+    gen.save(snapshot);
+    const std::string bytes = snapshot.str();
+
+    auto loaded = std::get<mnv::MNVGenerator<double, 6, mnv::Philox4x32>>(
+        mnv::MNVGenerator<double, 6, mnv::Philox4x32>::load(snapshot));
+    auto dynamic = std::get<mnv::DynamicMNVGenerator<double, mnv::Philox4x32>>(
+        mnv::DynamicMNVGenerator<double, mnv::Philox4x32>::load(bytes.data(), bytes.size()));
+
+    std::vector<mnv::valueVector<double, 6>> expected(2000);
+    std::vector<mnv::valueVector<double, 6>> fromLoaded(2000);
+    std::vector<mnv::valueVector<double, 6>> fromDynamic(2000);
+
+    gen.nextValues(expected.data(), expected.size());
+    loaded.nextValues(fromLoaded.data(), fromLoaded.size());
+    dynamic.nextValues(fromDynamic.data()->data(), fromDynamic.size());
+    EXPECT_EQ(std::memcmp(fromLoaded.data(), expected.data(), expected.size() * sizeof(expected[0])), 0);
+    EXPECT_EQ(std::memcmp(fromDynamic.data(), expected.data(), expected.size() * sizeof(expected[0])), 0);
+
+    gen.generateParallel(expected.data(), expected.size(), 3);
+    loaded.generateParallel(fromLoaded.data(), fromLoaded.size(), 1);
+    dynamic.generateParallel(fromDynamic.data()->data(), fromDynamic.size(), 2);
+    EXPECT_EQ(std::memcmp(fromLoaded.data(), expected.data(), expected.size() * sizeof(expected[0])), 0);
+    EXPECT_EQ(std::memcmp(fromDynamic.data(), expected.data(), expected.size() * sizeof(expected[0])), 0);
+
+    // standard engines are saved as well
+    auto mt = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 21));
+    mt.nextValues(values.data(), values.size());
+    std::stringstream mtSnapshot{};
+    mt.save(mtSnapshot);
+    auto mtLoaded = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::load(mtSnapshot));
+    const auto mtExpected = mt.nextValue();
+    const auto mtValue = mtLoaded.nextValue();
+    EXPECT_TRUE(std::equal(mtExpected.begin(), mtExpected.end(), mtValue.begin(), mtValue.end()));
+}
+
+TEST(snapshotTest, damagedSnapshotsAreRejected)
+{
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, {}, 3));
+    std::stringstream snapshot{};
+    gen.save(snapshot);
+    const std::string bytes = snapshot.str();
+
+    auto expectError = [](auto const &result, enum mnv::MNVGeneratorBuildError::type type)
+    {
+        auto errorPtr = std::get_if<mnv::MNVGeneratorBuildError>(&result);
+        ASSERT_NE(errorPtr, nullptr);
+        EXPECT_EQ(errorPtr->type, type);
+    };
+
+    expectError(mnv::MNVGenerator<double, 6>::load(bytes.data(), bytes.size() - 1), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+    expectError(mnv::MNVGenerator<double, 6>::load(bytes.data(), 10), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+    expectError(mnv::MNVGenerator<float, 6>::load(bytes.data(), bytes.size()), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+    expectError(mnv::MNVGenerator<double, 5>::load(bytes.data(), bytes.size()), mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+
+    std::string damaged = bytes;
+    damaged[0] = 'X';
+    expectError(mnv::MNVGenerator<double, 6>::load(damaged.data(), damaged.size()), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+
+    // negative diagonal entry of the factor
+    damaged = bytes;
+    const double negative = -1;
+    std::memcpy(damaged.data() + 64 + 2 * sizeof(double), &negative, sizeof(double));
+    expectError(mnv::DynamicMNVGenerator<double>::load(damaged.data(), damaged.size()), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+
+    // unreadable engine state
+    damaged = bytes;
+    damaged.back() = 'x';
+    expectError(mnv::MNVGenerator<double, 6>::load(damaged.data(), damaged.size()), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+
+    expectError(mnv::SnapshotFile::open(testing::TempDir() + "/mnv-does-not-exist.bin"), mnv::MNVGeneratorBuildError::type::SnapshotIsNotValid);
+}
+
+TEST(snapshotTest, mappedSnapshotIsShared)
+{
+    const size_t dim = 40;
+    std::vector<double> covariance(dim * dim);
+    for (size_t i = 0; i < dim; i++)
+    {
+        for (size_t j = 0; j < dim; j++)
+        {
+            covariance[i * dim + j] = std::pow(0.5, std::abs(static_cast<double>(i) - static_cast<double>(j)));
+        }
+    }
+    auto gen = std::get<mnv::DynamicMNVGenerator<double>>(
+        mnv::DynamicMNVGenerator<double>::build(covariance, std::vector<double>(dim, 1.0), 8));
+
+    const std::string path = testing::TempDir() + "/mnv-snapshot-test.bin";
+    {
+        std::ofstream out(path, std::ios::binary);
+        gen.save(out);
+        ASSERT_TRUE(out.good());
+    }
+
+    auto file = mnv::SnapshotFile::open(path);
+    auto filePtr = std::get_if<mnv::SnapshotFile>(&file);
+    ASSERT_NE(filePtr, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(filePtr->data()) % 64, 0u);
+    const auto shared = std::make_shared<mnv::SnapshotFile const>(std::move(*filePtr));
+
+    auto first = std::get<mnv::DynamicMNVGenerator<double>>(mnv::DynamicMNVGenerator<double>::load(shared));
+    auto second = std::get<mnv::DynamicMNVGenerator<double>>(mnv::DynamicMNVGenerator<double>::load(shared));
+    EXPECT_EQ(shared.use_count(), 3);
+
+    std::vector<double> expected(dim * 100);
+    std::vector<double> values(dim * 100);
+    gen.nextValues(expected.data(), 100);
+    first.nextValues(values.data(), 100);
+    EXPECT_EQ(values, expected);
+
+    // modifying one generator makes its own copy, the other one keeps reading the file
+    std::vector<double> shift(dim, 0.1);
+    first.update(shift.data());
+    gen.update(shift.data());
+    EXPECT_EQ(shared.use_count(), 2);
+
+    gen.nextValues(expected.data(), 100);
+    first.nextValues(values.data(), 100);
+    EXPECT_EQ(values, expected);
+
+    auto reference = std::get<mnv::DynamicMNVGenerator<double>>(
+        mnv::DynamicMNVGenerator<double>::build(covariance, std::vector<double>(dim, 1.0), 8));
+    reference.nextValues(expected.data(), 100);
+    second.nextValues(values.data(), 100);
+    EXPECT_EQ(values, expected);
+
+    std::remove(path.c_str());
+}
+
+TEST(mnvDistributionTest, samplersShareTheDistribution)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    const mnv::MatrixSq<double, 3> negDef{{{-2, 1, 0},
+                                           {1, -2, 0},
+                                           {0, 0, -2}}};
+    auto failed = mnv::MNVDistribution<double, 3>::build(negDef, {1, 1, 1});
+    auto errorPtr = std::get_if<mnv::MNVGeneratorBuildError>(&failed);
+    ASSERT_NE(errorPtr, nullptr);
+    EXPECT_EQ(errorPtr->type, mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    const auto distribution = std::get<mnv::MNVDistribution<double, 6>>(mnv::MNVDistribution<double, 6>::build(testMatrix, mean));
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(distribution.decomposedCovariance()) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(distribution.mean()) % 64, 0u);
+
+    // a handle is a pointer and the rng state, the params are not copied
+    auto first = distribution.sampler(7);
+    auto second = distribution.sampler<std::mt19937>(7);
+    EXPECT_EQ(first.distribution().decomposedCovariance(), distribution.decomposedCovariance());
+    EXPECT_EQ(second.distribution().mean(), distribution.mean());
+    static_assert(sizeof(mnv::MNVSampler<double, 64>) < 128);
+
+    // same values as a generator with the same seed and engine
+    auto philox = std::get<mnv::MNVGenerator<double, 6, mnv::Philox4x32>>(
+        mnv::MNVGenerator<double, 6, mnv::Philox4x32>::build(testMatrix, mean, 7));
+    auto mt = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 7));
+    for (size_t i = 0; i < 100; i++)
+    {
+        const auto expected = philox.nextValue();
+        const auto value = first.nextValue();
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), value.begin(), value.end())) << "value " << i;
+
+        const auto expectedMt = mt.nextValue();
+        const auto valueMt = second.nextValue();
+        ASSERT_TRUE(std::equal(expectedMt.begin(), expectedMt.end(), valueMt.begin(), valueMt.end())) << "value " << i;
+    }
+
+    // one handle per thread
+    std::vector<std::vector<mnv::valueVector<double, 6>>> results(4, std::vector<mnv::valueVector<double, 6>>(50000));
+    std::vector<std::thread> workers{};
+    for (size_t t = 0; t < results.size(); t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            auto sampler = distribution.sampler(100 + t);
+            sampler.nextValues(results[t].data(), results[t].size()); });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    for (auto &&values : results)
+    {
+        const auto cov = mnv::calculateCovarianceMatrix(values);
+        for (size_t i = 0; i < cov.size(); i++)
+        {
+            for (size_t j = 0; j < cov.size(); j++)
+            {
+                EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.15) << "i and j were " << i << " " << j << std::endl;
+            }
+        }
+    }
+}
+
+namespace
+{
+    // log N(x | mean, covariance) by Gaussian elimination, independent of the library's factor
+    template <size_t Dim>
+    double referenceLogPdf(mnv::MatrixSq<double, Dim> covariance, mnv::valueVector<double, Dim> const &mean, mnv::valueVector<double, Dim> const &x)
+    {
+        mnv::valueVector<double, Dim> rhs{};
+        for (size_t i = 0; i < Dim; i++)
+        {
+            rhs[i] = x[i] - mean[i];
+        }
+        const auto centered = rhs;
+
+        double logDeterminant = 0;
+        for (size_t k = 0; k < Dim; k++)
+        {
+            logDeterminant += std::log(covariance[k][k]);
+            for (size_t i = k + 1; i < Dim; i++)
+            {
+                const double factor = covariance[i][k] / covariance[k][k];
+                for (size_t j = k; j < Dim; j++)
+                {
+                    covariance[i][j] -= factor * covariance[k][j];
+                }
+                rhs[i] -= factor * rhs[k];
+            }
+        }
+        for (size_t i = Dim; i-- > 0;)
+        {
+            for (size_t j = i + 1; j < Dim; j++)
+            {
+                rhs[i] -= covariance[i][j] * rhs[j];
+            }
+            rhs[i] /= covariance[i][i];
+        }
+
+        double squaredDistance = 0;
+        for (size_t i = 0; i < Dim; i++)
+        {
+            squaredDistance += centered[i] * rhs[i];
+        }
+        return -(static_cast<double>(Dim) * std::log(2 * 3.14159265358979323846) + logDeterminant + squaredDistance) / 2;
+    }
+} // namespace
+
+TEST(scoringTest, logPdfWorks)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 3));
+    const auto distribution = std::get<mnv::MNVDistribution<double, 6>>(mnv::MNVDistribution<double, 6>::build(testMatrix, mean));
+    std::vector<double> covariance{};
+    for (auto &&row : testMatrix)
+    {
+        covariance.insert(covariance.end(), row.begin(), row.end());
+    }
+    auto dynamic = std::get<mnv::DynamicMNVGenerator<double>>(
+        mnv::DynamicMNVGenerator<double>::build(covariance.data(), mean.data(), mean.size(), 3));
+
+    // not a multiple of the block size
+    std::vector<mnv::valueVector<double, 6>> points(1000);
+    gen.nextValues(points.data(), points.size());
+
+    std::vector<double> logPdfs(points.size());
+    std::vector<double> distances(points.size());
+    gen.logPdf(points.data()->data(), points.size(), logPdfs.data());
+    gen.mahalanobis(points.data()->data(), points.size(), distances.data());
+
+    std::vector<double> dynamicLogPdfs(points.size());
+    std::vector<double> distributionDistances(points.size());
+    dynamic.logPdf(points.data()->data(), points.size(), dynamicLogPdfs.data());
+    distribution.mahalanobis(points.data()->data(), points.size(), distributionDistances.data());
+    EXPECT_EQ(dynamicLogPdfs, logPdfs);
+    EXPECT_EQ(distributionDistances, distances);
+
+    double sumOfSquares = 0;
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        const double expected = referenceLogPdf(testMatrix, mean, points[k]);
+        ASSERT_NEAR(logPdfs[k], expected, 1e-9 * std::abs(expected)) << "point " << k;
+        ASSERT_DOUBLE_EQ(gen.logPdf(points[k]), logPdfs[k]);
+        ASSERT_DOUBLE_EQ(distribution.logPdf(points[k]), logPdfs[k]);
+        ASSERT_DOUBLE_EQ(gen.mahalanobis(points[k]), distances[k]);
+        ASSERT_DOUBLE_EQ(dynamic.mahalanobis(points[k].data()), distances[k]);
+        sumOfSquares += distances[k] * distances[k];
+    }
+
+    // squared distances of the distribution's own values are chi-squared with Dim degrees of freedom
+    EXPECT_NEAR(sumOfSquares / static_cast<double>(points.size()), 6.0, 0.3);
+
+    // the cached log-determinant follows rank-1 updates
+    const mnv::valueVector<double, 6> v{{0.5, -0.2, 0.1, 0.3, 0.0, 1.0}};
+    gen.update(v);
+    auto updated = testMatrix;
+    for (size_t i = 0; i < 6; i++)
+    {
+        for (size_t j = 0; j < 6; j++)
+        {
+            updated[i][j] += v[i] * v[j];
+        }
+    }
+    const double expected = referenceLogPdf(updated, mean, points[0]);
+    EXPECT_NEAR(gen.logPdf(points[0]), expected, 1e-9 * std::abs(expected));
+}
+
+TEST(conditionalMnvGeneratorTest, buildWorks)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto expectError = [](auto const &result, enum mnv::MNVGeneratorBuildError::type type)
+    {
+        auto errorPtr = std::get_if<mnv::MNVGeneratorBuildError>(&result);
+        ASSERT_NE(errorPtr, nullptr);
+        EXPECT_EQ(errorPtr->type, type);
+    };
+
+    expectError(mnv::ConditionalMNVGenerator<double, 6>::build(testMatrix, mean, {1, 6}), mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+    expectError(mnv::ConditionalMNVGenerator<double, 6>::build(testMatrix, mean, {2, 2}), mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+    expectError(mnv::ConditionalMNVGenerator<double, 6>::build(testMatrix, mean, {0, 1, 2, 3, 4, 5}), mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+
+    const mnv::MatrixSq<double, 3> indefinite{{{1, 2, 0},
+                                               {2, 1, 0},
+                                               {0, 0, 1}}};
+    expectError(mnv::ConditionalMNVGenerator<double, 3>::build(indefinite, {}, {0}), mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+    expectError(mnv::ConditionalMNVGenerator<double, 3>::build(indefinite, {}, {2}), mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    // nothing observed is the plain distribution, drawn the same way as by MNVGenerator
+    auto plain = std::get<mnv::ConditionalMNVGenerator<double, 6>>(mnv::ConditionalMNVGenerator<double, 6>::build(testMatrix, mean, {}, 9));
+    auto gen = std::get<mnv::MNVGenerator<double, 6>>(mnv::MNVGenerator<double, 6>::build(testMatrix, mean, 9));
+    EXPECT_EQ(plain.freeIndices().size(), 6u);
+    for (size_t i = 0; i < 10; i++)
+    {
+        const auto expected = gen.nextValue();
+        const auto value = plain.nextValue();
+        for (size_t j = 0; j < 6; j++)
+        {
+            EXPECT_NEAR(value[j], expected[j], 1e-12);
+        }
+    }
+}
+
+TEST(conditionalMnvGeneratorTest, conditionalMomentsAreRight)
+{
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+    auto gen = std::get<mnv::ConditionalMNVGenerator<double, 6, mnv::Philox4x32>>(
+        mnv::ConditionalMNVGenerator<double, 6, mnv::Philox4x32>::build(testMatrix, mean, {4, 1}, 17));
+    EXPECT_EQ(gen.freeIndices(), (std::vector<size_t>{0, 2, 3, 5}));
+
+    // before conditioning the observed components sit at their means
+    EXPECT_EQ(gen.conditionalMean(), mean);
+
+    mnv::valueVector<double, 6> point{};
+    point[1] = 3;
+    point[4] = 13;
+    gen.condition(point);
+
+    // reference: conditional mean and covariance from the precision matrix,
+    // cov(free | observed) = Q22^-1 and mean = mean2 - Q22^-1 Q21 (x1 - mean1)
+    const std::vector<size_t> freeIdx{0, 2, 3, 5};
+    auto full = std::get<mnv::DynamicMNVGenerator<double>>(mnv::DynamicMNVGenerator<double>::build(
+        [&]()
+        {
+            std::vector<double> flat{};
+            for (auto &&row : testMatrix)
+            {
+                flat.insert(flat.end(), row.begin(), row.end());
+            }
+            return flat;
+        }(),
+        std::vector<double>(mean.begin(), mean.end()), 1));
+
+    const size_t amountOfValues = 200000;
+    std::vector<mnv::valueVector<double, 6>> values(amountOfValues);
+    gen.nextValues(values.data(), values.size());
+    for (auto &&value : values)
+    {
+        ASSERT_EQ(value[1], 3);
+        ASSERT_EQ(value[4], 13);
+    }
+
+    const auto conditionalMean = gen.conditionalMean();
+    const auto sampleMean = mnv::calculateMeanVector(values);
+    for (size_t j : freeIdx)
+    {
+        EXPECT_NEAR(sampleMean[j], conditionalMean[j], 0.03) << "component " << j;
+    }
+
+    // the conditional mean maximizes the joint density over the free components
+    const double atMean = full.logPdf(conditionalMean.data());
+    for (size_t j : freeIdx)
+    {
+        for (double step : {-1e-3, 1e-3})
+        {
+            auto shifted = conditionalMean;
+            shifted[j] += step;
+            EXPECT_LT(full.logPdf(shifted.data()), atMean) << "component " << j;
+        }
+    }
+
+    // the sample covariance of the free components is the inverse of the free block of the precision matrix:
+    // check cov * Q22 = I with Q computed by solving against the full factor
+    const auto cov = mnv::calculateCovarianceMatrix(values);
+    mnv::MatrixSq<double, 6> precision{};
+    for (size_t c = 0; c < 6; c++)
+    {
+        // column c of the precision matrix: the gradient of -logPdf is Q (x - mean)
+        mnv::valueVector<double, 6> probe = mean;
+        probe[c] += 1;
+        const double h = 1e-4;
+        for (size_t r = 0; r < 6; r++)
+        {
+            auto plus = probe;
+            auto minus = probe;
+            plus[r] += h;
+            minus[r] -= h;
+            precision[r][c] = -(full.logPdf(plus.data()) - full.logPdf(minus.data())) / (2 * h);
+        }
+    }
+    for (size_t a = 0; a < freeIdx.size(); a++)
+    {
+        for (size_t b = 0; b < freeIdx.size(); b++)
+        {
+            double product = 0;
+            for (size_t k = 0; k < freeIdx.size(); k++)
+            {
+                product += cov[freeIdx[a]][freeIdx[k]] * precision[freeIdx[k]][freeIdx[b]];
+            }
+            EXPECT_NEAR(product, a == b ? 1.0 : 0.0, 0.03) << "a and b were " << a << " " << b;
+        }
+    }
+}
+
+TEST(truncatedMnvGeneratorTest, truncatedStandardNormalWorks)
+{
+    // mean of N(0, 1) truncated to [a, b] is (pdf(a) - pdf(b)) / (cdf(b) - cdf(a)), the tails are taken from the side
+    // where the difference of cdfs does not cancel
+    const double inf = std::numeric_limits<double>::infinity();
+    auto pdf = [](double x)
+    { return std::isfinite(x) ? std::exp(-0.5 * x * x) / std::sqrt(2 * M_PI) : 0.0; };
+    auto upperTail = [](double x)
+    { return 0.5 * std::erfc(x / std::sqrt(2.0)); };
+
+    mnv::Philox4x32 engine{3};
+    const size_t amountOfValues = 200000;
+    for (auto [a, b] : {std::pair{-1.0, 1.0}, std::pair{-inf, 0.5}, std::pair{0.1, 0.2}, std::pair{2.0, 3.0}, std::pair{6.0, inf}, std::pair{-inf, -9.0}})
+    {
+        const double mass = a >= 0 ? upperTail(a) - upperTail(b) : upperTail(-b) - upperTail(-a);
+        const double expected = (pdf(a) - pdf(b)) / mass;
+
+        double sum = 0;
+        for (size_t i = 0; i < amountOfValues; i++)
+        {
+            const double x = mnv::internal::truncatedStandardNormal(engine, a, b);
+            ASSERT_TRUE(a <= x && x <= b) << "interval was " << a << " " << b;
+            sum += x;
+        }
+        EXPECT_NEAR(sum / amountOfValues, expected, 0.005 * std::max(1.0, std::abs(expected))) << "interval was " << a << " " << b;
+    }
+}
+
+TEST(truncatedMnvGeneratorTest, boundsAndMomentsAreRight)
+{
+    using Generator = mnv::TruncatedMNVGenerator<double, 6, mnv::Philox4x32>;
+    const double inf = std::numeric_limits<double>::infinity();
+    const mnv::valueVector<double, 6> mean{{0, 2, 4, 8, 16, 32}};
+
+    auto expectError = [](auto &&built, enum mnv::MNVGeneratorBuildError::type type)
+    {
+        ASSERT_TRUE(std::holds_alternative<mnv::MNVGeneratorBuildError>(built));
+        EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(built).type, type);
+    };
+    mnv::valueVector<double, 6> empty{};
+    expectError(Generator::build(testMatrix, mean, empty, empty, 1), mnv::MNVGeneratorBuildError::type::BoundsAreNotValid);
+    mnv::valueVector<double, 6> nan{};
+    nan.fill(std::numeric_limits<double>::quiet_NaN());
+    expectError(Generator::build(testMatrix, mean, nan, mean, 1), mnv::MNVGeneratorBuildError::type::BoundsAreNotValid);
+
+    // an easy box first: the chain must agree with rejection from the full distribution
+    mnv::valueVector<double, 6> lowerBounds{};
+    mnv::valueVector<double, 6> upperBounds{};
+    upperBounds.fill(inf);
+    lowerBounds = mean;
+    lowerBounds[0] = -1;
+    lowerBounds[3] = -inf;
+    upperBounds[3] = 9;
+
+    auto gen = std::get<Generator>(Generator::build(testMatrix, mean, lowerBounds, upperBounds, 5, 2));
+    auto full = std::get<mnv::MNVGenerator<double, 6, mnv::Philox4x32>>(mnv::MNVGenerator<double, 6, mnv::Philox4x32>::build(testMatrix, mean, 6));
+
+    const size_t amountOfValues = 100000;
+    std::vector<mnv::valueVector<double, 6>> values(amountOfValues);
+    gen.nextValues(values.data(), values.size());
+
+    std::vector<mnv::valueVector<double, 6>> accepted{};
+    while (accepted.size() < amountOfValues)
+    {
+        auto value = full.nextValue();
+        bool inside = true;
+        for (size_t i = 0; i < 6; i++)
+        {
+            inside = inside && lowerBounds[i] <= value[i] && value[i] <= upperBounds[i];
+        }
+        if (inside)
+        {
+            accepted.push_back(value);
+        }
+    }
+
+    for (auto &&value : values)
+    {
+        for (size_t i = 0; i < 6; i++)
+        {
+            ASSERT_GE(value[i], lowerBounds[i]);
+            ASSERT_LE(value[i], upperBounds[i]);
+        }
+    }
+    const auto sampleMean = mnv::calculateMeanVector(values);
+    const auto referenceMean = mnv::calculateMeanVector(accepted);
+    const auto sampleCov = mnv::calculateCovarianceMatrix(values);
+    const auto referenceCov = mnv::calculateCovarianceMatrix(accepted);
+    for (size_t i = 0; i < 6; i++)
+    {
+        EXPECT_NEAR(sampleMean[i], referenceMean[i], 0.05) << "component " << i;
+        for (size_t j = 0; j < 6; j++)
+        {
+            EXPECT_NEAR(sampleCov[i][j], referenceCov[i][j], 0.1 * std::sqrt(referenceCov[i][i] * referenceCov[j][j]) + 0.02)
+                << "i and j were " << i << " " << j;
+        }
+    }
+
+    // a box far in the tail, where rejection would essentially never accept: values still come and stay inside
+    mnv::valueVector<double, 6> farBounds{};
+    for (size_t i = 0; i < 6; i++)
+    {
+        farBounds[i] = mean[i] + 4 * std::sqrt(testMatrix[i][i]);
+    }
+    upperBounds.fill(inf);
+    auto tail = std::get<Generator>(Generator::build(testMatrix, mean, farBounds, upperBounds, 7));
+    tail.nextValues(values.data(), 10000);
+    for (size_t k = 0; k < 10000; k++)
+    {
+        for (size_t i = 0; i < 6; i++)
+        {
+            ASSERT_GE(values[k][i], farBounds[i]);
+        }
+    }
+
+    // deep-tail marginals: with a diagonal covariance every component is a one-dimensional truncated normal,
+    // mean + sd * (pdf(a) - pdf(b)) / (cdf(b) - cdf(a)) in standardized bounds. A chain stuck near its start would be off.
+    const mnv::valueVector<double, 6> variances{{1, 4, 0.25, 9, 2, 0.5}};
+    mnv::MatrixSq<double, 6> diagonal{};
+    for (size_t i = 0; i < 6; i++)
+    {
+        diagonal[i][i] = variances[i];
+    }
+    const std::vector<std::pair<double, double>> standardized{{5, inf}, {-inf, -6}, {3, 3.5}, {-8, -7.5}, {4, inf}, {-inf, -5}};
+    for (size_t i = 0; i < 6; i++)
+    {
+        const double sd = std::sqrt(variances[i]);
+        lowerBounds[i] = mean[i] + sd * standardized[i].first;
+        upperBounds[i] = mean[i] + sd * standardized[i].second;
+    }
+    auto independent = std::get<Generator>(Generator::build(diagonal, mean, lowerBounds, upperBounds, 8));
+    independent.nextValues(values.data(), 20000);
+    values.resize(20000);
+
+    auto pdf = [](double x)
+    { return std::isfinite(x) ? std::exp(-0.5 * x * x) / std::sqrt(2 * M_PI) : 0.0; };
+    auto upperTail = [](double x)
+    { return 0.5 * std::erfc(x / std::sqrt(2.0)); };
+    const auto tailMean = mnv::calculateMeanVector(values);
+    for (size_t i = 0; i < 6; i++)
+    {
+        const auto [a, b] = standardized[i];
+        const double mass = a >= 0 ? upperTail(a) - upperTail(b) : upperTail(-b) - upperTail(-a);
+        const double expected = mean[i] + std::sqrt(variances[i]) * (pdf(a) - pdf(b)) / mass;
+        EXPECT_NEAR(tailMean[i], expected, 0.01 * std::sqrt(variances[i])) << "component " << i;
+    }
+}
+
+TEST(mixtureMnvGeneratorTest, buildWorks)
+{
+    using Generator = mnv::MixtureMNVGenerator<double, 6, mnv::Philox4x32>;
+    const mnv::valueVector<double, 6> mean{};
+
+    auto expectError = [](auto &&built, enum mnv::MNVGeneratorBuildError::type type)
+    {
+        ASSERT_TRUE(std::holds_alternative<mnv::MNVGeneratorBuildError>(built));
+        EXPECT_EQ(std::get<mnv::MNVGeneratorBuildError>(built).type, type);
+    };
+    expectError(Generator::build({}, {}, {}, 1), mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+    expectError(Generator::build({1, 1}, {testMatrix}, {mean, mean}, 1), mnv::MNVGeneratorBuildError::type::DimensionsDoNotMatch);
+    expectError(Generator::build({1, -1}, {testMatrix, testMatrix}, {mean, mean}, 1), mnv::MNVGeneratorBuildError::type::WeightsAreNotValid);
+    expectError(Generator::build({0, 0}, {testMatrix, testMatrix}, {mean, mean}, 1), mnv::MNVGeneratorBuildError::type::WeightsAreNotValid);
+    mnv::MatrixSq<double, 6> notPositiveDefinite = testMatrix;
+    notPositiveDefinite[0][0] = -1;
+    expectError(Generator::build({1, 1}, {testMatrix, notPositiveDefinite}, {mean, mean}, 1), mnv::MNVGeneratorBuildError::type::CovarianceMatrixIsNotPositiveDefinite);
+
+    // a single component is the plain distribution
+    auto gen = std::get<Generator>(Generator::build({2}, {testMatrix}, {mean}, 1));
+    EXPECT_EQ(gen.componentCount(), 1u);
+    std::vector<mnv::valueVector<double, 6>> values(100000);
+    gen.nextValues(values.data(), values.size());
+    const auto cov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < 6; i++)
+    {
+        for (size_t j = 0; j < 6; j++)
+        {
+            EXPECT_NEAR(cov[i][j], testMatrix[i][j], 0.1) << "i and j were " << i << " " << j;
+        }
+    }
+}
+
+TEST(mixtureMnvGeneratorTest, componentsAndMomentsAreRight)
+{
+    using Generator = mnv::MixtureMNVGenerator<double, 2, mnv::Philox4x32>;
+    const std::vector<double> weights{5, 0, 3, 2};
+    const std::vector<mnv::MatrixSq<double, 2>> covariances{
+        {{{1, 0.5}, {0.5, 2}}}, {{{1, 0}, {0, 1}}}, {{{0.5, -0.2}, {-0.2, 0.5}}}, {{{3, 1}, {1, 1}}}};
+    const std::vector<mnv::valueVector<double, 2>> means{{{-20, 0}}, {{0, 0}}, {{0, 20}}, {{20, -20}}};
+
+    auto gen = std::get<Generator>(Generator::build(weights, covariances, means, 9));
+    EXPECT_EQ(gen.componentCount(), 3u);
+
+    // batches of several sizes, single values among them
+    const size_t amountOfValues = 300000;
+    std::vector<mnv::valueVector<double, 2>> values(amountOfValues);
+    size_t filled = 0;
+    for (size_t batch = 1; filled < amountOfValues; batch = batch * 3 + 1)
+    {
+        const size_t count = std::min(batch, amountOfValues - filled);
+        gen.nextValues(values.data() + filled, count);
+        filled += count;
+    }
+    values.back() = gen.nextValue();
+
+    // the components are far apart, so the nearest mean tells where a value came from
+    std::vector<size_t> counts(means.size());
+    for (auto &&value : values)
+    {
+        size_t nearest = 0;
+        for (size_t c = 1; c < means.size(); c++)
+        {
+            auto distance = [&](size_t k)
+            { return std::hypot(value[0] - means[k][0], value[1] - means[k][1]); };
+            nearest = distance(c) < distance(nearest) ? c : nearest;
+        }
+        counts[nearest]++;
+    }
+    EXPECT_EQ(counts[1], 0u);
+    for (size_t c : {size_t{0}, size_t{2}, size_t{3}})
+    {
+        EXPECT_NEAR(static_cast<double>(counts[c]) / amountOfValues, weights[c] / 10, 0.005) << "component " << c;
+    }
+
+    // mean sum w_c mean_c, covariance sum w_c (cov_c + mean_c mean_c^T) - mean mean^T
+    mnv::valueVector<double, 2> expectedMean{};
+    mnv::MatrixSq<double, 2> expectedCov{};
+    for (size_t c = 0; c < means.size(); c++)
+    {
+        const double w = weights[c] / 10;
+        for (size_t i = 0; i < 2; i++)
+        {
+            expectedMean[i] += w * means[c][i];
+            for (size_t j = 0; j < 2; j++)
+            {
+                expectedCov[i][j] += w * (covariances[c][i][j] + means[c][i] * means[c][j]);
+            }
+        }
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        for (size_t j = 0; j < 2; j++)
+        {
+            expectedCov[i][j] -= expectedMean[i] * expectedMean[j];
+        }
+    }
+
+    const auto sampleMean = mnv::calculateMeanVector(values);
+    const auto sampleCov = mnv::calculateCovarianceMatrix(values);
+    for (size_t i = 0; i < 2; i++)
+    {
+        EXPECT_NEAR(sampleMean[i], expectedMean[i], 0.1) << "component " << i;
+        for (size_t j = 0; j < 2; j++)
+        {
+            EXPECT_NEAR(sampleCov[i][j], expectedCov[i][j], 0.02 * std::abs(expectedCov[i][j]) + 0.5) << "i and j were " << i << " " << j;
+        }
+    }
+}